@@ -1,71 +1,281 @@
+#include "FileReader.hpp"
+#include "HashingStream.hpp"
+#include "TreeHash.hpp"
+
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <numeric>
 #include <print>
+#include <random>
+#include <semaphore>
+#include <sstream>
 #include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if HASHING_STREAM_POSIX
+#include <fcntl.h>
+#endif // HASHING_STREAM_POSIX
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define CRC64_X86 1
+#else
+#define CRC64_X86 0
+#endif
+
+// a CRC of up to 64 bits in the Rocksoft model, CRC-64/ECMA-182 from a bare Poly, the data is consumed SLICES bytes at
+// a time through as many tables, 1 being the classic byte at a time loop, or folded with carry-less multiplications,
+// the narrower CRCs run on the high bits of the register and the reflected ones on its low bits, bit-reversed
 class CRC64
 {
   public:
     enum Poly : uint64_t
     {
-        ECMA182 = 0x42F0E1EBA9EA3693
+        ECMA182 = 0x42F0E1EBA9EA3693,
+        ISO = 0x000000000000001B
+    };
+
+    // poly MSB first without its x^width term, init is the register before any reflection, xorOut applies to the output
+    struct Model
+    {
+        uint8_t width;
+        uint64_t poly;
+        uint64_t init;
+        bool reflectIn;
+        bool reflectOut;
+        uint64_t xorOut;
     };
 
-    constexpr CRC64(const Poly aPoly) noexcept : mTable(GenerateTable(aPoly))
+    static constexpr Model CRC_64_ECMA_182{64, ECMA182, 0, false, false, 0};
+    static constexpr Model CRC_64_XZ{64, ECMA182, ~uint64_t{}, true, true, ~uint64_t{}};
+    static constexpr Model CRC_64_GO_ISO{64, ISO, ~uint64_t{}, true, true, ~uint64_t{}};
+    static constexpr Model CRC_32C{32, 0x1EDC6F41, 0xFFFFFFFF, true, true, 0xFFFFFFFF};
+    static constexpr Model CRC_32{32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF};
+
+    enum class Simd : uint8_t
+    {
+        SCALAR,
+        PCLMUL, // 16 bytes per multiplication
+        VPCLMUL // 64 bytes
+    };
+
+    static constexpr size_t SLICES_MAX = 16;
+    // the carry-less multiplications when the CPU has them, slicing by SLICES_MAX otherwise
+    static constexpr size_t SLICES_BEST = 0;
+
+    static constexpr uint64_t PARALLEL_CHUNK_MIN = 8 << 20;
+
+    constexpr CRC64(const Poly aPoly) noexcept : CRC64(Model{64, aPoly, 0, false, false, 0})
     {
     }
 
+    constexpr CRC64(const Model &aModel) noexcept
+        : mModel(aModel), mShift(64 - aModel.width), mPoly(aModel.poly << mShift),
+          mInit(ToNormal(aModel.init << mShift)), mTables(GenerateTables(mPoly, aModel.reflectIn)),
+          mFolding(GenerateFolding(mPoly, aModel.reflectIn)), mPowers(GeneratePowers(mPoly))
+    {
+    }
+
+    template <size_t SLICES = SLICES_BEST>
     constexpr uint64_t DigestData(const std::span<const uint8_t> aData) const noexcept
     {
-        return Update(aData, 0);
+        return Finalize(Update<SLICES>(aData, mInit));
     }
 
+    template <size_t SLICES = SLICES_BEST>
     constexpr uint64_t DigestString(const std::string_view aString) const noexcept
     {
-        return Update({reinterpret_cast<const uint8_t *>(aString.data()), aString.size()}, 0);
+        // the chars cannot be read as bytes while constant evaluated, they are copied a block at a time
+        if (std::is_constant_evaluated())
+        {
+            auto crc = mInit;
+            std::array<uint8_t, 64> block{};
+            for (size_t i = 0; i < aString.size(); i += block.size())
+            {
+                const auto size = std::min(block.size(), aString.size() - i);
+                std::transform(aString.begin() + i, aString.begin() + i + size, block.begin(),
+                               [](const char aChar) { return static_cast<uint8_t>(aChar); });
+                crc = Update<SLICES>({block.data(), size}, crc);
+            }
+            return Finalize(crc);
+        }
+
+        return Finalize(Update<SLICES>({reinterpret_cast<const uint8_t *>(aString.data()), aString.size()}, mInit));
     }
 
-    uint64_t DigestFile(const std::filesystem::path &aFile, const uint64_t aChunkSize = 64 * 1024) const noexcept
+    uint64_t DigestFile(const std::filesystem::path &aFile, const uint64_t aChunkSize = FileReader::CHUNK_SIZE,
+                        const FileReader::Mode aMode = FileReader::Mode::MAP) const noexcept
     {
-        std::ifstream ifs(aFile, std::ios::binary);
-        if (!ifs)
+        Hasher hasher(*this);
+        const auto update = [&](const std::span<const uint8_t> aData) { hasher.Update(aData); };
+        if (!FileReader::Read(aFile, update, aMode, aChunkSize))
         {
             return {};
         }
 
-        std::vector<uint8_t> buffer(aChunkSize);
+        return hasher.Digest();
+    }
+
+    // the CRC of data fed in pieces, it refers to its CRC64 which must outlive it
+    class Hasher
+    {
+      public:
+        constexpr explicit Hasher(const CRC64 &aCRC64) noexcept : mCRC64(aCRC64), mRegister(aCRC64.mInit)
+        {
+        }
+
+        constexpr bool Update(const std::span<const uint8_t> aData) noexcept
+        {
+            if (aData.empty())
+            {
+                return false;
+            }
+
+            mRegister = mCRC64.Update<SLICES_BEST>(aData, mRegister);
+            mSize += aData.size();
+            return true;
+        }
+
+        constexpr uint64_t Digest() const noexcept
+        {
+            return mCRC64.Finalize(mRegister);
+        }
+
+        // the bytes fed so far, what Combine needs after this one
+        constexpr uint64_t Size() const noexcept
+        {
+            return mSize;
+        }
+
+      private:
+        const CRC64 &mCRC64;
+        uint64_t mRegister;
+        uint64_t mSize{};
+    };
+
+    // chunks of at least PARALLEL_CHUNK_MIN on up to aThreadsCount threads, 0 for one per core, merged by Combine
+    uint64_t DigestDataParallel(const std::span<const uint8_t> aData, size_t aThreadsCount = 0) const
+    {
+        if (!aThreadsCount)
+        {
+            aThreadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        const auto count =
+            static_cast<size_t>(std::clamp<uint64_t>(aData.size() / PARALLEL_CHUNK_MIN, 1, aThreadsCount));
+        if (count == 1)
+        {
+            return DigestData(aData);
+        }
+
+        // the last chunk takes the remainder
+        const auto chunkSize = aData.size() / count;
+        const auto chunk = [&](const size_t aIndex) {
+            return aData.subspan(aIndex * chunkSize, aIndex + 1 < count ? chunkSize : std::dynamic_extent);
+        };
+
+        std::vector<uint64_t> crcs(count);
+        {
+            std::vector<std::jthread> threads;
+            for (size_t i = 1; i < count; i++)
+            {
+                threads.emplace_back([&, i] { crcs[i] = DigestData(chunk(i)); });
+            }
+            crcs[0] = DigestData(chunk(0));
+        }
 
-        uint64_t crc{};
-        while (ifs.read(reinterpret_cast<char *>(buffer.data()), buffer.size()))
+        auto crc = crcs[0];
+        for (size_t i = 1; i < count; i++)
         {
-            crc = Update(buffer, crc);
+            crc = Combine(crc, crcs[i], chunk(i).size());
         }
 
-        const auto fileSizeTotal = std::filesystem::file_size(aFile);
-        return Update({buffer.data(), fileSizeTotal % aChunkSize}, crc);
+        return crc;
+    }
+
+    // the CRC of some data followed by aSizeNext bytes from the CRC of each, the registers differ by the first one
+    // moved on by the second's bytes, its init excepted as the second's register already starts from it
+    constexpr uint64_t Combine(const uint64_t aCRC, const uint64_t aCRCNext, const uint64_t aSizeNext) const noexcept
+    {
+        const auto first = ToNormal(Register(aCRC) ^ mInit);
+        return Finalize(ToNormal(MultiplyMod(first, ShiftOf(aSizeNext)) ^ ToNormal(Register(aCRCNext))));
+    }
+
+    // the kernel of SLICES_BEST, the best one supported is picked at startup, for tests and benchmarks
+    static Simd GetSimd() noexcept
+    {
+        return sSimd;
+    }
+
+    static bool SetSimd(const Simd aSimd) noexcept
+    {
+        if (aSimd > DetectSimd())
+        {
+            return false;
+        }
+
+        sSimd = aSimd;
+        return true;
     }
 
   private:
-    static constexpr std::array<uint64_t, 256> GenerateTable(const Poly aPoly) noexcept
+    using Table = std::array<uint64_t, 256>;
+
+    static constexpr uint64_t Reflect(uint64_t aValue) noexcept
+    {
+        aValue = (aValue >> 1 & 0x5555555555555555) | (aValue & 0x5555555555555555) << 1;
+        aValue = (aValue >> 2 & 0x3333333333333333) | (aValue & 0x3333333333333333) << 2;
+        aValue = (aValue >> 4 & 0x0F0F0F0F0F0F0F0F) | (aValue & 0x0F0F0F0F0F0F0F0F) << 4;
+        return std::byteswap(aValue);
+    }
+
+    // from the register to the CRC MSB first in the high bits and back, the same bit reversal both ways
+    constexpr uint64_t ToNormal(const uint64_t aRegister) const noexcept
     {
-        std::array<uint64_t, 256> table{};
+        return mModel.reflectIn ? Reflect(aRegister) : aRegister;
+    }
+
+    constexpr uint64_t Finalize(const uint64_t aRegister) const noexcept
+    {
+        const auto crc = ToNormal(aRegister);
+        return (mModel.reflectOut ? Reflect(crc) : crc >> mShift) ^ mModel.xorOut;
+    }
+
+    constexpr uint64_t Register(const uint64_t aCRC) const noexcept
+    {
+        const auto crc = aCRC ^ mModel.xorOut;
+        return ToNormal(mModel.reflectOut ? Reflect(crc) : crc << mShift);
+    }
+
+    // MSB first, or LSB first on the reflected poly when aReflected
+    static constexpr Table GenerateTable(const uint64_t aPoly, const bool aReflected) noexcept
+    {
+        const auto poly = aReflected ? Reflect(aPoly) : aPoly;
+
+        Table table{};
         for (uint64_t i = 0; i < table.size(); i++)
         {
-            uint64_t crc{};
-            uint64_t c = i << 56;
+            uint64_t crc = aReflected ? i : i << 56;
             for (uint64_t j = 0; j < 8; j++)
             {
-                const auto xorPoly = (crc ^ c) & (std::numeric_limits<int64_t>::max() + 1);
+                const auto xorPoly = aReflected ? crc & 1 : crc >> 63;
 
-                crc <<= 1;
+                crc = aReflected ? crc >> 1 : crc << 1;
                 if (xorPoly)
                 {
-                    crc ^= aPoly;
+                    crc ^= poly;
                 }
-                c <<= 1;
             }
 
             table[i] = crc;
@@ -74,30 +284,748 @@ class CRC64
         return table;
     }
 
+    // the table k is the CRC of a byte followed by k zeros
+    static constexpr std::array<Table, SLICES_MAX> GenerateTables(const uint64_t aPoly, const bool aReflected) noexcept
+    {
+        std::array<Table, SLICES_MAX> tables{};
+        tables[0] = GenerateTable(aPoly, aReflected);
+
+        for (size_t k = 1; k < tables.size(); k++)
+        {
+            for (size_t i = 0; i < tables[k].size(); i++)
+            {
+                const auto previous = tables[k - 1][i];
+                tables[k][i] = aReflected ? (previous >> 8) ^ tables[0][previous & 0xFF]
+                                          : (previous << 8) ^ tables[0][previous >> 56];
+            }
+        }
+
+        return tables;
+    }
+
+    // the factors that move a block on by d bits, in the order of the halves they multiply, the first byte's half
+    // holds the high terms of the block, the reflected ones are a term short since their products come out one bit up
+    using Fold = std::array<uint64_t, 2>;
+
+    // P is x^64 + poly, x128 is x^128 mod P and mu is floor(x^128 / P) less its x^64 term
+    struct Folding
+    {
+        Fold by128, by256, by384, by512, by1024, by1536, by2048;
+        uint64_t x128;
+        uint64_t mu;
+    };
+
+    static constexpr uint64_t XPowerMod(const uint64_t aPoly, const size_t aPower) noexcept
+    {
+        uint64_t remainder = 1;
+        for (size_t i = 0; i < aPower; i++)
+        {
+            const auto carry = remainder >> 63;
+            remainder <<= 1;
+            if (carry)
+            {
+                remainder ^= aPoly;
+            }
+        }
+
+        return remainder;
+    }
+
+    // long division of x^128 - x^64 P = x^64 poly, only the high half of the remainder picks the quotient bits
+    static constexpr uint64_t DivideX128(const uint64_t aPoly) noexcept
+    {
+        uint64_t quotient{};
+        uint64_t high = aPoly;
+        for (int bit = 63; bit >= 0; bit--)
+        {
+            if (high >> bit & 1)
+            {
+                quotient |= uint64_t{1} << bit;
+                high ^= (uint64_t{1} << bit) ^ (bit ? aPoly >> (64 - bit) : 0);
+            }
+        }
+
+        return quotient;
+    }
+
+    static constexpr Folding GenerateFolding(const uint64_t aPoly, const bool aReflected) noexcept
+    {
+        const auto fold = [&](const size_t aDistance) {
+            if (aReflected)
+            {
+                return Fold{Reflect(XPowerMod(aPoly, aDistance + 63)), Reflect(XPowerMod(aPoly, aDistance - 1))};
+            }
+            return Fold{XPowerMod(aPoly, aDistance), XPowerMod(aPoly, aDistance + 64)};
+        };
+
+        return {fold(128),  fold(256),  fold(384), fold(512), fold(1024), fold(1536), fold(2048), XPowerMod(aPoly, 128),
+                DivideX128(aPoly)};
+    }
+
+    // the product of two remainders mod P, MSB first, P need not be irreducible
+    static constexpr uint64_t MultiplyMod(const uint64_t aLeft, const uint64_t aRight, const uint64_t aPoly) noexcept
+    {
+        uint64_t product{};
+        for (int bit = 63; bit >= 0; bit--)
+        {
+            const auto carry = product >> 63;
+            product <<= 1;
+            if (carry)
+            {
+                product ^= aPoly;
+            }
+            if (aRight >> bit & 1)
+            {
+                product ^= aLeft;
+            }
+        }
+
+        return product;
+    }
+
+    constexpr uint64_t MultiplyMod(const uint64_t aLeft, const uint64_t aRight) const noexcept
+    {
+        return MultiplyMod(aLeft, aRight, mPoly);
+    }
+
+    // the power k is x^(8 2^k) mod P, the shift of 2^k bytes
+    static constexpr std::array<uint64_t, 64> GeneratePowers(const uint64_t aPoly) noexcept
+    {
+        std::array<uint64_t, 64> powers{};
+        powers[0] = XPowerMod(aPoly, 8);
+        for (size_t k = 1; k < powers.size(); k++)
+        {
+            powers[k] = MultiplyMod(powers[k - 1], powers[k - 1], aPoly);
+        }
+
+        return powers;
+    }
+
+    // x^(8 aSize) mod P
+    constexpr uint64_t ShiftOf(const uint64_t aSize) const noexcept
+    {
+        uint64_t shift = 1;
+        for (size_t k = 0; k < mPowers.size(); k++)
+        {
+            if (aSize >> k & 1)
+            {
+                shift = MultiplyMod(shift, mPowers[k]);
+            }
+        }
+
+        return shift;
+    }
+
+    static Simd DetectSimd() noexcept
+    {
+#if CRC64_X86
+        if (__builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx512bw"))
+        {
+            return Simd::VPCLMUL;
+        }
+
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        {
+            return Simd::PCLMUL;
+        }
+#endif // CRC64_X86
+
+        return Simd::SCALAR;
+    }
+
+    static inline Simd sSimd = DetectSimd();
+
   private:
-    constexpr uint64_t Update(const std::span<const uint8_t> aData, uint64_t aCRC) const noexcept
+    template <size_t SLICES>
+    constexpr uint64_t Update(const std::span<const uint8_t> aData, const uint64_t aRegister) const noexcept
+    {
+        return mModel.reflectIn ? Update<SLICES, true>(aData, aRegister) : Update<SLICES, false>(aData, aRegister);
+    }
+
+    template <size_t SLICES, bool REFLECTED>
+    constexpr uint64_t Update(const std::span<const uint8_t> aData, uint64_t aRegister) const noexcept
     {
-        for (uint64_t i = 0; i < aData.size(); i++)
+        static_assert(SLICES == SLICES_BEST || SLICES == 1 || SLICES == 8 || SLICES == 16,
+                      "slicing by 1, 8 or 16 bytes");
+
+        if constexpr (SLICES == SLICES_BEST)
         {
-            const uint64_t t = ((aCRC >> 56) ^ aData[i]) & std::numeric_limits<uint8_t>::max();
-            aCRC = mTable[t] ^ (aCRC << 8);
+#if CRC64_X86
+            if (!std::is_constant_evaluated())
+            {
+                switch (sSimd)
+                {
+                case Simd::VPCLMUL:
+                    return UpdateVpclmul<REFLECTED>(aData, aRegister);
+
+                case Simd::PCLMUL:
+                    return UpdatePclmul<REFLECTED>(aData, aRegister);
+
+                default:
+                    break;
+                }
+            }
+#endif // CRC64_X86
+
+            return Update<SLICES_MAX, REFLECTED>(aData, aRegister);
+        }
+
+        uint64_t i = 0;
+        if constexpr (SLICES > 1)
+        {
+            for (; i + SLICES <= aData.size(); i += SLICES)
+            {
+                aRegister = Slice<SLICES, REFLECTED>(aData.data() + i, aRegister);
+            }
+        }
+
+        for (; i < aData.size(); i++)
+        {
+            if constexpr (REFLECTED)
+            {
+                aRegister = mTables[0][(aRegister ^ aData[i]) & 0xFF] ^ (aRegister >> 8);
+            }
+            else
+            {
+                aRegister = mTables[0][(aRegister >> 56) ^ aData[i]] ^ (aRegister << 8);
+            }
         }
 
-        return aCRC;
+        return aRegister;
+    }
+
+    // the register goes into the first 8 bytes, the bytes after them only go through their tables so that their
+    // lookups do not wait for the previous block
+    template <size_t SLICES, bool REFLECTED>
+    constexpr uint64_t Slice(const uint8_t *aData, const uint64_t aRegister) const noexcept
+    {
+        const auto block = aRegister ^ Read<REFLECTED>(aData);
+        if constexpr (SLICES == 16)
+        {
+            return Lookup8<SLICES, 0, REFLECTED>(aData, block) ^ Lookup8<SLICES, 8, REFLECTED>(aData, block);
+        }
+        else
+        {
+            return Lookup8<SLICES, 0, REFLECTED>(aData, block);
+        }
     }
 
+    // paired up rather than a chain of 8 xors, unrolled by hand as -O2 keeps the loops
+    template <size_t SLICES, size_t FIRST, bool REFLECTED>
+    constexpr uint64_t Lookup8(const uint8_t *aData, const uint64_t aBlock) const noexcept
+    {
+        return ((Lookup<SLICES, FIRST, REFLECTED>(aData, aBlock) ^
+                 Lookup<SLICES, FIRST + 1, REFLECTED>(aData, aBlock)) ^
+                (Lookup<SLICES, FIRST + 2, REFLECTED>(aData, aBlock) ^
+                 Lookup<SLICES, FIRST + 3, REFLECTED>(aData, aBlock))) ^
+               ((Lookup<SLICES, FIRST + 4, REFLECTED>(aData, aBlock) ^
+                 Lookup<SLICES, FIRST + 5, REFLECTED>(aData, aBlock)) ^
+                (Lookup<SLICES, FIRST + 6, REFLECTED>(aData, aBlock) ^
+                 Lookup<SLICES, FIRST + 7, REFLECTED>(aData, aBlock)));
+    }
+
+    template <size_t SLICES, size_t BYTE, bool REFLECTED>
+    constexpr uint64_t Lookup(const uint8_t *aData, const uint64_t aBlock) const noexcept
+    {
+        if constexpr (BYTE < sizeof(uint64_t))
+        {
+            const auto shift = REFLECTED ? 8 * BYTE : 56 - 8 * BYTE;
+            return mTables[SLICES - 1 - BYTE][static_cast<uint8_t>(aBlock >> shift)];
+        }
+        else
+        {
+            return mTables[SLICES - 1 - BYTE][aData[BYTE]];
+        }
+    }
+
+    // big-endian, little-endian when REFLECTED
+    template <bool REFLECTED> static constexpr uint64_t Read(const uint8_t *aData) noexcept
+    {
+        uint64_t value{};
+        if (std::is_constant_evaluated())
+        {
+            for (size_t i = 0; i < sizeof(value); i++)
+            {
+                value = REFLECTED ? value | uint64_t{aData[i]} << (8 * i) : value << 8 | aData[i];
+            }
+            return value;
+        }
+
+        std::memcpy(&value, aData, sizeof(value));
+        constexpr auto endian = REFLECTED ? std::endian::little : std::endian::big;
+        return std::endian::native == endian ? value : std::byteswap(value);
+    }
+
+#if CRC64_X86
+    // the data is a polynomial whose top term is the first bit, 128 bits of it are moved on by d bits with a product
+    // per half, the remainder of the last block is taken by a Barrett reduction and the bytes left over go to the
+    // tables, every block loads byte-reversed so that the first byte lands in the high half, the reflected ones load
+    // as they are with the first byte in the low half and their top term in bit 0
+    template <bool REFLECTED> __attribute__((target("pclmul,sse4.1"))) static __m128i LoadPclmul(const uint8_t *aData)
+    {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(aData));
+        if constexpr (REFLECTED)
+        {
+            return block;
+        }
+        else
+        {
+            return _mm_shuffle_epi8(block, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+        }
+    }
+
+    // the register into the first 8 bytes
+    template <bool REFLECTED> __attribute__((target("pclmul,sse4.1"))) static __m128i RegisterPclmul(uint64_t aRegister)
+    {
+        const auto value = static_cast<int64_t>(aRegister);
+        return REFLECTED ? _mm_set_epi64x(0, value) : _mm_set_epi64x(value, 0);
+    }
+
+    // aBlock moved on and added to aNext
+    __attribute__((target("pclmul,sse4.1"))) static __m128i FoldPclmul(const __m128i aBlock, const Fold &aFold,
+                                                                       const __m128i aNext) noexcept
+    {
+        const auto fold = _mm_loadu_si128(reinterpret_cast<const __m128i *>(aFold.data()));
+        return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(aBlock, fold, 0x00),
+                                           _mm_clmulepi64_si128(aBlock, fold, 0x11)),
+                             aNext);
+    }
+
+    __attribute__((target("pclmul,sse4.1"))) static __m128i Clmul(const uint64_t aLeft, const uint64_t aRight) noexcept
+    {
+        return _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<int64_t>(aLeft)),
+                                    _mm_cvtsi64_si128(static_cast<int64_t>(aRight)), 0x00);
+    }
+
+    // the register of the data folded into aBlock, that is aBlock x^64 mod P, a reflected block is reversed first
+    template <bool REFLECTED>
+    __attribute__((target("pclmul,sse4.1"))) uint64_t ReducePclmul(const __m128i aBlock) const noexcept
+    {
+        auto high = static_cast<uint64_t>(_mm_extract_epi64(aBlock, 1));
+        auto low = static_cast<uint64_t>(_mm_cvtsi128_si64(aBlock));
+        if constexpr (REFLECTED)
+        {
+            const auto first = low;
+            low = Reflect(high);
+            high = Reflect(first);
+        }
+
+        // the high half moved 128 bits on, the low one 64, leaves 128 bits to divide by P
+        const auto product = Clmul(high, mFolding.x128);
+        const auto productHigh = static_cast<uint64_t>(_mm_extract_epi64(product, 1)) ^ low;
+        const auto productLow = static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+
+        const auto quotient =
+            productHigh ^ static_cast<uint64_t>(_mm_extract_epi64(Clmul(productHigh, mFolding.mu), 1));
+        const auto crc = productLow ^ static_cast<uint64_t>(_mm_cvtsi128_si64(Clmul(quotient, mPoly)));
+        return REFLECTED ? Reflect(crc) : crc;
+    }
+
+    // four chains of 16 bytes 512 bits apart so that the multiplications overlap, single blocks after them
+    template <bool REFLECTED>
+    __attribute__((target("pclmul,sse4.1"))) uint64_t UpdatePclmul(const std::span<const uint8_t> aData,
+                                                                   const uint64_t aRegister) const noexcept
+    {
+        if (aData.size() < 16)
+        {
+            return Update<SLICES_MAX, REFLECTED>(aData, aRegister);
+        }
+
+        const auto *data = aData.data();
+
+        __m128i block;
+        size_t i;
+        if (aData.size() >= 64)
+        {
+            auto block0 = _mm_xor_si128(LoadPclmul<REFLECTED>(data), RegisterPclmul<REFLECTED>(aRegister));
+            auto block1 = LoadPclmul<REFLECTED>(data + 16);
+            auto block2 = LoadPclmul<REFLECTED>(data + 32);
+            auto block3 = LoadPclmul<REFLECTED>(data + 48);
+            for (i = 64; i + 64 <= aData.size(); i += 64)
+            {
+                block0 = FoldPclmul(block0, mFolding.by512, LoadPclmul<REFLECTED>(data + i));
+                block1 = FoldPclmul(block1, mFolding.by512, LoadPclmul<REFLECTED>(data + i + 16));
+                block2 = FoldPclmul(block2, mFolding.by512, LoadPclmul<REFLECTED>(data + i + 32));
+                block3 = FoldPclmul(block3, mFolding.by512, LoadPclmul<REFLECTED>(data + i + 48));
+            }
+
+            block = FoldPclmul(block0, mFolding.by384,
+                               FoldPclmul(block1, mFolding.by256, FoldPclmul(block2, mFolding.by128, block3)));
+        }
+        else
+        {
+            block = _mm_xor_si128(LoadPclmul<REFLECTED>(data), RegisterPclmul<REFLECTED>(aRegister));
+            i = 16;
+        }
+
+        for (; i + 16 <= aData.size(); i += 16)
+        {
+            block = FoldPclmul(block, mFolding.by128, LoadPclmul<REFLECTED>(data + i));
+        }
+
+        return Update<SLICES_MAX, REFLECTED>(aData.subspan(i), ReducePclmul<REFLECTED>(block));
+    }
+
+    // the same on four 128-bit lanes per register, four registers of 64 bytes 2048 bits apart, what is left under
+    // 256 bytes goes to UpdatePclmul
+    // GCC 12 warns about the undefined vectors inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    template <bool REFLECTED>
+    __attribute__((target("avx512f,avx512bw,vpclmulqdq,pclmul,sse4.1"))) static __m512i
+    LoadVpclmul(const uint8_t *aData) noexcept
+    {
+        const auto block = _mm512_loadu_si512(aData);
+        if constexpr (REFLECTED)
+        {
+            return block;
+        }
+        else
+        {
+            const auto reverse =
+                _mm512_broadcast_i32x4(_mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+            return _mm512_shuffle_epi8(block, reverse);
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw,vpclmulqdq,pclmul,sse4.1"))) static __m512i
+    FoldVpclmul(const __m512i aBlock, const Fold &aFold, const __m512i aNext) noexcept
+    {
+        const auto fold = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i *>(aFold.data())));
+        return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(aBlock, fold, 0x00),
+                                         _mm512_clmulepi64_epi128(aBlock, fold, 0x11), aNext, 0x96);
+    }
+
+    template <bool REFLECTED>
+    __attribute__((target("avx512f,avx512bw,vpclmulqdq,pclmul,sse4.1"))) uint64_t
+    UpdateVpclmul(const std::span<const uint8_t> aData, const uint64_t aRegister) const noexcept
+    {
+        if (aData.size() < 256)
+        {
+            return UpdatePclmul<REFLECTED>(aData, aRegister);
+        }
+
+        const auto *data = aData.data();
+
+        auto block0 = _mm512_xor_si512(LoadVpclmul<REFLECTED>(data),
+                                       _mm512_zextsi128_si512(RegisterPclmul<REFLECTED>(aRegister)));
+        auto block1 = LoadVpclmul<REFLECTED>(data + 64);
+        auto block2 = LoadVpclmul<REFLECTED>(data + 128);
+        auto block3 = LoadVpclmul<REFLECTED>(data + 192);
+
+        size_t i;
+        for (i = 256; i + 256 <= aData.size(); i += 256)
+        {
+            block0 = FoldVpclmul(block0, mFolding.by2048, LoadVpclmul<REFLECTED>(data + i));
+            block1 = FoldVpclmul(block1, mFolding.by2048, LoadVpclmul<REFLECTED>(data + i + 64));
+            block2 = FoldVpclmul(block2, mFolding.by2048, LoadVpclmul<REFLECTED>(data + i + 128));
+            block3 = FoldVpclmul(block3, mFolding.by2048, LoadVpclmul<REFLECTED>(data + i + 192));
+        }
+
+        const auto block =
+            FoldVpclmul(block0, mFolding.by1536,
+                        FoldVpclmul(block1, mFolding.by1024, FoldVpclmul(block2, mFolding.by512, block3)));
+
+        // the first lane is the lowest one
+        const auto lanes = FoldPclmul(_mm512_extracti32x4_epi32(block, 0), mFolding.by384,
+                                      FoldPclmul(_mm512_extracti32x4_epi32(block, 1), mFolding.by256,
+                                                 FoldPclmul(_mm512_extracti32x4_epi32(block, 2), mFolding.by128,
+                                                            _mm512_extracti32x4_epi32(block, 3))));
+
+        return UpdatePclmul<REFLECTED>(aData.subspan(i), ReducePclmul<REFLECTED>(lanes));
+    }
+
+#pragma GCC diagnostic pop
+#endif // CRC64_X86
+
   private:
-    const std::array<uint64_t, 256> mTable;
+    const Model mModel;
+    const int mShift; // the register bits under the CRC, 64 - width
+    const uint64_t mPoly;
+    const uint64_t mInit;
+    const std::array<Table, SLICES_MAX> mTables;
+    const Folding mFolding;
+    const std::array<uint64_t, 64> mPowers;
 };
 
+// every variant against the byte at a time one on every length and alignment, aCheck is the CRC of "123456789"
+bool Verify(const CRC64 &aCRC64, const uint64_t aCheck)
+{
+    std::vector<uint8_t> data(1'000);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 3));
+    }
+
+    if (aCRC64.DigestString<1>("123456789") != aCheck || aCRC64.DigestString<8>("123456789") != aCheck ||
+        aCRC64.DigestString<16>("123456789") != aCheck || aCRC64.DigestString("123456789") != aCheck)
+    {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < 16; offset++)
+    {
+        for (size_t size = 0; offset + size <= data.size(); size++)
+        {
+            const std::span<const uint8_t> span(data.data() + offset, size);
+            const auto crc = aCRC64.DigestData<1>(span);
+            if (aCRC64.DigestData<8>(span) != crc || aCRC64.DigestData<16>(span) != crc)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// each kernel of the carry-less multiplications against the tables on random lengths and alignments
+bool VerifyFolding(const CRC64 &aCRC64)
+{
+    std::mt19937_64 random(42);
+    std::vector<uint8_t> data(64 << 10);
+    std::ranges::generate(data, [&] { return static_cast<uint8_t>(random()); });
+
+    const auto simdBest = CRC64::GetSimd();
+    bool verified = true;
+    for (const auto simd : {CRC64::Simd::SCALAR, CRC64::Simd::PCLMUL, CRC64::Simd::VPCLMUL})
+    {
+        if (!CRC64::SetSimd(simd))
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < 10'000 && verified; i++)
+        {
+            // mostly short, around the sizes that switch kernels
+            const auto offset = static_cast<size_t>(random() % 64);
+            const auto size = static_cast<size_t>(random() % (i % 4 ? 1'024 : data.size() - offset));
+
+            const std::span<const uint8_t> span(data.data() + offset, size);
+            verified = aCRC64.DigestData(span) == aCRC64.DigestData<1>(span);
+        }
+    }
+    CRC64::SetSimd(simdBest);
+
+    return verified;
+}
+
+// the CRC of random splits merged back, and the parallel digest on 4 threads
+bool VerifyCombine(const CRC64 &aCRC64)
+{
+    std::mt19937_64 random(42);
+    std::vector<uint8_t> data(4 * CRC64::PARALLEL_CHUNK_MIN + 12'345);
+    std::ranges::generate(data, [&] { return static_cast<uint8_t>(random()); });
+
+    for (size_t i = 0; i < 1'000; i++)
+    {
+        const auto size = static_cast<size_t>(random() % (i % 4 ? 1'024 : 1 << 20));
+        const auto split = static_cast<size_t>(random() % (size + 1));
+
+        const std::span<const uint8_t> span(data.data(), size);
+        const auto combined = aCRC64.Combine(aCRC64.DigestData(span.first(split)),
+                                             aCRC64.DigestData(span.subspan(split)), size - split);
+        if (combined != aCRC64.DigestData(span))
+        {
+            return false;
+        }
+    }
+
+    return aCRC64.DigestDataParallel(data, 4) == aCRC64.DigestData(data);
+}
+
+// the hasher fed in uneven pieces, then the same data through both directions of each tee adapter
+bool VerifyStreaming(const CRC64 &aCRC64)
+{
+    std::vector<uint8_t> data(100'003);
+    std::iota(data.begin(), data.end(), uint8_t{});
+    const auto crc = aCRC64.DigestData(data);
+
+    CRC64::Hasher hasher(aCRC64);
+    for (size_t offset = 0, piece = 1; offset < data.size(); offset += piece, piece = piece * 3 % 1'021 + 1)
+    {
+        hasher.Update(std::span(data).subspan(offset, std::min(piece, data.size() - offset)));
+    }
+    if (hasher.Digest() != crc || hasher.Size() != data.size())
+    {
+        return false;
+    }
+
+    // a character, then the rest as a block
+    std::stringstream stream;
+    HashingStreambuf writing(stream.rdbuf(), CRC64::Hasher(aCRC64));
+    std::ostream out(&writing);
+    out.put(static_cast<char>(data[0])).write(reinterpret_cast<const char *>(data.data() + 1), data.size() - 1);
+    if (!out.flush() || writing.Digest() != crc)
+    {
+        return false;
+    }
+
+    // a character, small blocks through the buffer, then large ones past it
+    HashingStreambuf reading(stream.rdbuf(), CRC64::Hasher(aCRC64));
+    std::istream in(&reading);
+    std::vector<uint8_t> copy(data.size());
+    auto *bytes = reinterpret_cast<char *>(copy.data());
+    in.get(bytes[0]).read(bytes + 1, 99).read(bytes + 100, copy.size() - 100);
+    if (!in || in.peek() != std::istream::traits_type::eof() || copy != data || reading.Digest() != crc)
+    {
+        return false;
+    }
+
+#if HASHING_STREAM_POSIX
+    const auto file = std::filesystem::temp_directory_path() / "CRC64.tee";
+    const auto descriptor = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    HashingDescriptor writer(descriptor, CRC64::Hasher(aCRC64));
+    HashingDescriptor reader(descriptor, CRC64::Hasher(aCRC64));
+    std::ranges::fill(copy, uint8_t{});
+    const auto verified = writer.WriteFully(data.data(), data.size()) && lseek(descriptor, 0, SEEK_SET) == 0 &&
+                          reader.ReadFully(copy.data(), copy.size()) == static_cast<ssize_t>(copy.size()) &&
+                          !reader.Read(copy.data(), 1) && copy == data && writer.Digest() == crc &&
+                          reader.Digest() == crc;
+    close(descriptor);
+    std::filesystem::remove(file);
+
+    // a line from a pipe still open comes back without waiting for more, the write end is closed after a second to let
+    // a reader that waits anyway see the end
+    int ends[2];
+    if (!verified || pipe(ends))
+    {
+        return false;
+    }
+
+    constexpr std::string_view line = "a line\n";
+    std::string lineRead;
+    std::binary_semaphore lineDone(0);
+    std::thread lineReader;
+    if (write(ends[1], line.data(), line.size()) == static_cast<ssize_t>(line.size()))
+    {
+        lineReader = std::thread([&] {
+            std::ifstream pipeStream("/dev/fd/" + std::to_string(ends[0]), std::ios::binary);
+            HashingStreambuf lineTee(pipeStream.rdbuf(), CRC64::Hasher(aCRC64));
+            std::istream lineIn(&lineTee);
+            if (std::getline(lineIn, lineRead) && lineTee.Digest() != aCRC64.DigestString(line))
+            {
+                lineRead.clear();
+            }
+            lineDone.release();
+        });
+    }
+
+    const auto lineInTime = lineReader.joinable() && lineDone.try_acquire_for(std::chrono::seconds(1));
+    close(ends[1]);
+    if (lineReader.joinable())
+    {
+        lineReader.join();
+    }
+    close(ends[0]);
+
+    return lineInTime && lineRead == line.substr(0, line.size() - 1);
+#else
+    return true;
+#endif // HASHING_STREAM_POSIX
+}
+
+// the reference cycles of the TSC, not the core's own
+template <typename Digest>
+void Benchmark(const std::span<const uint8_t> aData, const std::string_view aName, Digest &&aDigest)
+{
+    const auto start = std::chrono::steady_clock::now();
+#if CRC64_X86
+    const auto cyclesStart = __rdtsc();
+#endif // CRC64_X86
+
+    const auto crc = aDigest(aData);
+
+#if CRC64_X86
+    const auto cycles = __rdtsc() - cyclesStart;
+#endif // CRC64_X86
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    std::print("{:>13}: {:x}, {:.2f} GB/s", aName, crc, aData.size() / duration.count() / 1'000'000'000);
+#if CRC64_X86
+    std::print(", {:.2f} B per reference cycle", static_cast<double>(aData.size()) / cycles);
+#endif // CRC64_X86
+    std::println();
+}
+
 int main()
 {
     const CRC64 crc64(CRC64::Poly::ECMA182);
 
     std::println("{:x}", crc64.DigestFile(__FILE__));
+    std::println("{:x}", crc64.DigestFile(__FILE__, FileReader::CHUNK_SIZE, FileReader::Mode::READ));
+    std::println("{:x}", crc64.DigestFile(__FILE__, FileReader::CHUNK_SIZE, FileReader::Mode::STREAM));
     std::println("{:x}", crc64.DigestString("Caricioplan"));
     const std::vector<uint8_t> bytes{0x48, 0x42, 0x61, 0x6E, 0x6E};
     std::println("{:x}", crc64.DigestData(bytes));
 
+    // the tables and the digests also work at compile time
+    static constexpr CRC64 crcXz(CRC64::CRC_64_XZ);
+    static_assert(crcXz.DigestString("123456789") == 0x995DC9BBDF1939FA);
+
+    // leaves of 1 KiB, a different digest than the one of the whole file
+    TreeHash tree([&crc64](const std::span<const uint8_t> aData) { return crc64.DigestData(aData); }, 1024);
+    const auto root = tree.DigestFile(__FILE__);
+    std::println("{:x} over {} leaves", root, tree.Leaves().size());
+
+    // the check values of the catalogue, with a narrow one reflected on output only
+    constexpr CRC64::Model crc32Bzip2{32, 0x04C11DB7, 0xFFFFFFFF, false, false, 0xFFFFFFFF};
+    constexpr CRC64::Model crc12Umts{12, 0x80F, 0, false, true, 0};
+    const std::array<std::pair<CRC64::Model, uint64_t>, 7> models{{{CRC64::CRC_64_ECMA_182, 0x6C40DF5F0B497347},
+                                                                   {CRC64::CRC_64_XZ, 0x995DC9BBDF1939FA},
+                                                                   {CRC64::CRC_64_GO_ISO, 0xB90956C775A41001},
+                                                                   {CRC64::CRC_32C, 0xE3069283},
+                                                                   {CRC64::CRC_32, 0xCBF43926},
+                                                                   {crc32Bzip2, 0xFC891918},
+                                                                   {crc12Umts, 0xDAF}}};
+    for (const auto &[model, check] : models)
+    {
+        const CRC64 crc(model);
+        if (!Verify(crc, check) || !VerifyFolding(crc) || !VerifyCombine(crc) || !VerifyStreaming(crc))
+        {
+            std::println("the CRC-{} of poly {:x} disagrees with the check value or itself", model.width, model.poly);
+            return 1;
+        }
+    }
+
+    // the fold constants come from the poly, any other one works as well
+    for (const auto poly : {CRC64::Poly::ISO, static_cast<CRC64::Poly>(0xAD93D23594C935A9)})
+    {
+        if (!VerifyFolding(CRC64(poly)))
+        {
+            std::println("the carry-less multiplications disagree with the tables on {:x}", std::to_underlying(poly));
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> data(64 << 20);
+    std::iota(data.begin(), data.end(), uint8_t{});
+    Benchmark(data, "slicing by 1", [&](const auto aData) { return crc64.DigestData<1>(aData); });
+    Benchmark(data, "slicing by 8", [&](const auto aData) { return crc64.DigestData<8>(aData); });
+    Benchmark(data, "slicing by 16", [&](const auto aData) { return crc64.DigestData<16>(aData); });
+
+    const auto simdBest = CRC64::GetSimd();
+    if (CRC64::SetSimd(CRC64::Simd::PCLMUL))
+    {
+        Benchmark(data, "pclmulqdq", [&](const auto aData) { return crc64.DigestData(aData); });
+    }
+    if (CRC64::SetSimd(CRC64::Simd::VPCLMUL))
+    {
+        Benchmark(data, "vpclmulqdq", [&](const auto aData) { return crc64.DigestData(aData); });
+    }
+    CRC64::SetSimd(simdBest);
+
+    Benchmark(data, "parallel", [&](const auto aData) { return crc64.DigestDataParallel(aData); });
+
+    const CRC64 crc32c(CRC64::CRC_32C);
+    Benchmark(data, "CRC-32C", [&](const auto aData) { return crc32c.DigestData(aData); });
+
     return 0;
 }
@@ -0,0 +1,585 @@
+#include "XXHash64.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define FILE_HASH_INDEX_POSIX 1
+#else
+#define FILE_HASH_INDEX_POSIX 0
+#endif
+
+// the digests of the files under a directory with their size, modification time and inode, a rescan walks the
+// directories in parallel and re-hashes only the files whose metadata changed
+class FileHashIndex
+{
+  public:
+    struct Entry
+    {
+        uint64_t size{};
+        int64_t modified{}; // nanoseconds
+        uint64_t inode{};   // 0 off POSIX
+        uint64_t digest{};
+
+        bool SameMetadata(const Entry &aEntry) const noexcept
+        {
+            return size == aEntry.size && modified == aEntry.modified && inode == aEntry.inode;
+        }
+    };
+
+    // the paths are relative to the directory scanned, with '/' between the names
+    struct Changes
+    {
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        std::vector<std::string> modified;
+
+        uint64_t hashedCount{};
+    };
+
+  public:
+    // the files are stat-ed before they are hashed so that a change while hashing shows up on the next scan, the
+    // symbolic links are not followed
+    Changes Scan(const std::filesystem::path &aDirectory, const size_t aThreadsCount = 0)
+    {
+        Walk walk;
+        walk.directories.emplace_back(aDirectory, std::string());
+
+        std::vector<Found> founds(aThreadsCount ? aThreadsCount : std::max(std::thread::hardware_concurrency(), 1u));
+        {
+            std::vector<std::jthread> threads;
+            for (size_t i = 1; i < founds.size(); i++)
+            {
+                threads.emplace_back([&, i] { WalkDirectories(walk, founds[i]); });
+            }
+            WalkDirectories(walk, founds.front());
+        }
+
+        size_t count{};
+        for (const auto &found : founds)
+        {
+            count += found.entries.size();
+        }
+
+        Changes changes;
+        std::unordered_map<std::string, Entry> entries;
+        entries.reserve(count);
+        for (auto &found : founds)
+        {
+            changes.hashedCount += found.hashedCount;
+            std::ranges::move(found.added, std::back_inserter(changes.added));
+            std::ranges::move(found.modified, std::back_inserter(changes.modified));
+
+            for (auto &[path, entry] : found.entries)
+            {
+                entries.emplace(std::move(path), entry);
+            }
+        }
+
+        for (const auto &[path, entry] : mEntries)
+        {
+            if (!entries.contains(path))
+            {
+                changes.removed.push_back(path);
+            }
+        }
+
+        std::ranges::sort(changes.added);
+        std::ranges::sort(changes.removed);
+        std::ranges::sort(changes.modified);
+
+        mEntries = std::move(entries);
+        return changes;
+    }
+
+    // false if the index is missing or corrupt, it is then left empty
+    bool Load(const std::filesystem::path &aFile)
+    {
+        mEntries.clear();
+
+        std::ifstream ifs(aFile, std::ios::binary);
+        std::error_code error;
+        const auto size = std::filesystem::file_size(aFile, error);
+        if (!ifs || error || size < HEADER_SIZE + sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        std::string data(size, '\0');
+        if (!ifs.read(data.data(), data.size()))
+        {
+            return false;
+        }
+
+        const std::string_view contents(data.data(), data.size() - sizeof(uint64_t));
+        Reader reader{data};
+        reader.offset = contents.size();
+        if (reader.Fixed() != XXHash64::DigestString(contents))
+        {
+            return false;
+        }
+
+        reader = Reader{contents};
+        if (reader.Fixed() != MAGIC)
+        {
+            return false;
+        }
+
+        const auto count = reader.Fixed();
+        mEntries.reserve(std::min<uint64_t>(count, contents.size()));
+
+        std::string path;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            // the path shares a prefix with the previous one
+            const auto shared = reader.Variable();
+            const auto suffix = reader.Bytes(reader.Variable());
+            if (!reader.valid || shared > path.size())
+            {
+                mEntries.clear();
+                return false;
+            }
+            path.resize(shared);
+            path += suffix;
+
+            Entry entry;
+            entry.size = reader.Variable();
+            entry.modified = static_cast<int64_t>(reader.Fixed());
+            entry.inode = reader.Variable();
+            entry.digest = reader.Fixed();
+            mEntries.emplace(path, entry);
+        }
+
+        if (!reader.valid || reader.offset != contents.size())
+        {
+            mEntries.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    // written next to aFile then renamed over it, the paths sorted so that each one is stored after the prefix it
+    // shares with the previous one
+    bool Save(const std::filesystem::path &aFile) const
+    {
+        std::vector<const std::pair<const std::string, Entry> *> entries;
+        entries.reserve(mEntries.size());
+        for (const auto &entry : mEntries)
+        {
+            entries.push_back(&entry);
+        }
+        std::ranges::sort(entries, {}, [](const auto *aEntry) -> const std::string & { return aEntry->first; });
+
+        std::string data;
+        AppendFixed(data, MAGIC);
+        AppendFixed(data, entries.size());
+
+        std::string_view previous;
+        for (const auto *entry : entries)
+        {
+            const auto &[path, metadata] = *entry;
+            const auto shared = std::ranges::mismatch(path, previous).in1 - path.begin();
+
+            AppendVariable(data, shared);
+            AppendVariable(data, path.size() - shared);
+            data.append(path, shared);
+            AppendVariable(data, metadata.size);
+            AppendFixed(data, static_cast<uint64_t>(metadata.modified));
+            AppendVariable(data, metadata.inode);
+            AppendFixed(data, metadata.digest);
+
+            previous = path;
+        }
+        AppendFixed(data, XXHash64::DigestString(data));
+
+        auto temporary = aFile;
+        temporary += ".tmp";
+        {
+            std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+            if (!ofs.write(data.data(), data.size()) || !ofs.flush())
+            {
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, aFile, error);
+        return !error;
+    }
+
+  public:
+    const Entry *Find(const std::string &aPath) const
+    {
+        const auto found = mEntries.find(aPath);
+        return found != mEntries.end() ? &found->second : nullptr;
+    }
+
+    size_t Count() const noexcept
+    {
+        return mEntries.size();
+    }
+
+  private:
+    // the directories left to list with their paths relative to the one scanned, and how many are being listed
+    struct Walk
+    {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::pair<std::filesystem::path, std::string>> directories;
+        size_t listingCount{};
+    };
+
+    // what a thread found, merged once the walk ends
+    struct Found
+    {
+        std::vector<std::pair<std::string, Entry>> entries;
+        std::vector<std::string> added;
+        std::vector<std::string> modified;
+        uint64_t hashedCount{};
+    };
+
+    void WalkDirectories(Walk &aWalk, Found &aFound) const
+    {
+        std::vector<std::pair<std::filesystem::path, std::string>> subdirectories;
+        while (true)
+        {
+            std::unique_lock lock(aWalk.mutex);
+            aWalk.wake.wait(lock, [&] { return !aWalk.directories.empty() || !aWalk.listingCount; });
+            if (aWalk.directories.empty())
+            {
+                return;
+            }
+
+            const auto [directory, relative] = std::move(aWalk.directories.back());
+            aWalk.directories.pop_back();
+            aWalk.listingCount++;
+            lock.unlock();
+
+            ListDirectory(directory, relative, subdirectories, aFound);
+
+            lock.lock();
+            aWalk.listingCount--;
+            std::ranges::move(subdirectories, std::back_inserter(aWalk.directories));
+            if (!subdirectories.empty() || !aWalk.listingCount)
+            {
+                aWalk.wake.notify_all();
+            }
+            subdirectories.clear();
+        }
+    }
+
+#if FILE_HASH_INDEX_POSIX
+    // readdir and fstatat next to the directory, about twice as fast as std::filesystem and a stat by full path
+    void ListDirectory(const std::filesystem::path &aDirectory, const std::string &aRelative,
+                       std::vector<std::pair<std::filesystem::path, std::string>> &aSubdirectories, Found &aFound) const
+    {
+        auto *directory = opendir(aDirectory.c_str());
+        if (!directory)
+        {
+            return;
+        }
+
+        const auto descriptor = dirfd(directory);
+        while (const auto *item = readdir(directory))
+        {
+            const std::string_view name = item->d_name;
+            if (name == "." || name == ".." || item->d_type == DT_LNK)
+            {
+                continue;
+            }
+
+            auto relative = aRelative;
+            relative += name;
+
+            if (item->d_type == DT_DIR)
+            {
+                aSubdirectories.emplace_back(aDirectory / name, relative + '/');
+                continue;
+            }
+
+            // the type is unknown on some file systems
+            struct stat status;
+            if (fstatat(descriptor, item->d_name, &status, AT_SYMLINK_NOFOLLOW))
+            {
+                continue;
+            }
+
+            if (S_ISDIR(status.st_mode))
+            {
+                aSubdirectories.emplace_back(aDirectory / name, relative + '/');
+                continue;
+            }
+
+            if (!S_ISREG(status.st_mode))
+            {
+                continue;
+            }
+
+#ifdef __APPLE__
+            const auto &modified = status.st_mtimespec;
+#else
+            const auto &modified = status.st_mtim;
+#endif // __APPLE__
+
+            Entry entry;
+            entry.size = static_cast<uint64_t>(status.st_size);
+            entry.modified = static_cast<int64_t>(modified.tv_sec) * 1'000'000'000 + modified.tv_nsec;
+            entry.inode = static_cast<uint64_t>(status.st_ino);
+            Record(aDirectory, name, std::move(relative), entry, aFound);
+        }
+
+        closedir(directory);
+    }
+#else
+    void ListDirectory(const std::filesystem::path &aDirectory, const std::string &aRelative,
+                       std::vector<std::pair<std::filesystem::path, std::string>> &aSubdirectories, Found &aFound) const
+    {
+        std::error_code error;
+        const auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::directory_iterator it(aDirectory, options, error), end; !error && it != end;
+             it.increment(error))
+        {
+            std::error_code entryError;
+            if (it->is_symlink(entryError))
+            {
+                continue;
+            }
+
+            auto relative = aRelative + it->path().filename().generic_string();
+            if (it->is_directory(entryError))
+            {
+                aSubdirectories.emplace_back(it->path(), relative + '/');
+                continue;
+            }
+
+            if (!it->is_regular_file(entryError))
+            {
+                continue;
+            }
+
+            Entry entry;
+            entry.size = it->file_size(entryError);
+            const auto modified = it->last_write_time(entryError).time_since_epoch();
+            entry.modified = std::chrono::duration_cast<std::chrono::nanoseconds>(modified).count();
+            if (!entryError)
+            {
+                Record(aDirectory, it->path().filename().native(), std::move(relative), entry, aFound);
+            }
+        }
+    }
+#endif // FILE_HASH_INDEX_POSIX
+
+    // the digest kept if the metadata did not change
+    template <typename Name>
+    void Record(const std::filesystem::path &aDirectory, const Name &aName, std::string &&aRelative, Entry aEntry,
+                Found &aFound) const
+    {
+        const auto found = mEntries.find(aRelative);
+        if (found != mEntries.end() && found->second.SameMetadata(aEntry))
+        {
+            aEntry.digest = found->second.digest;
+        }
+        else
+        {
+            aEntry.digest = XXHash64::DigestFile(aDirectory / aName);
+            aFound.hashedCount++;
+
+            if (found == mEntries.end())
+            {
+                aFound.added.push_back(aRelative);
+            }
+            else if (found->second.digest != aEntry.digest)
+            {
+                aFound.modified.push_back(aRelative);
+            }
+        }
+
+        aFound.entries.emplace_back(std::move(aRelative), aEntry);
+    }
+
+  private:
+    // little-endian whatever the machine
+    static void AppendFixed(std::string &aData, const uint64_t aValue)
+    {
+        for (size_t i = 0; i < sizeof(aValue); i++)
+        {
+            aData.push_back(static_cast<char>(aValue >> (8 * i)));
+        }
+    }
+
+    // 7 bits per byte, the high bit set while more follow
+    static void AppendVariable(std::string &aData, uint64_t aValue)
+    {
+        for (; aValue >= 0x80; aValue >>= 7)
+        {
+            aData.push_back(static_cast<char>(aValue | 0x80));
+        }
+        aData.push_back(static_cast<char>(aValue));
+    }
+
+    // valid stays false once a read went past the end
+    struct Reader
+    {
+        std::string_view data;
+        size_t offset{};
+        bool valid = true;
+
+        uint64_t Fixed() noexcept
+        {
+            if (data.size() - offset < sizeof(uint64_t))
+            {
+                valid = false;
+                return {};
+            }
+
+            uint64_t value{};
+            for (size_t i = 0; i < sizeof(value); i++)
+            {
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset++])) << (8 * i);
+            }
+            return value;
+        }
+
+        uint64_t Variable() noexcept
+        {
+            uint64_t value{};
+            for (size_t shift = 0; shift < std::numeric_limits<uint64_t>::digits; shift += 7)
+            {
+                if (offset == data.size())
+                {
+                    break;
+                }
+
+                const auto byte = static_cast<uint8_t>(data[offset++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+
+            valid = false;
+            return {};
+        }
+
+        std::string_view Bytes(const uint64_t aSize) noexcept
+        {
+            if (data.size() - offset < aSize)
+            {
+                valid = false;
+                return {};
+            }
+
+            offset += aSize;
+            return data.substr(offset - aSize, aSize);
+        }
+    };
+
+  private:
+    static constexpr uint64_t MAGIC = 0x0000'0001'5849'4846; // "FHIX" and the version
+    static constexpr size_t HEADER_SIZE = 2 * sizeof(uint64_t);
+
+    std::unordered_map<std::string, Entry> mEntries;
+};
+
+// 1M files of a few bytes in 1000 directories, a cold scan, a warm one from the index saved and loaded, then one
+// after some files were added, removed and modified
+void BenchmarkRescan()
+{
+    constexpr size_t directoriesCount = 1'000;
+    constexpr size_t filesPerDirectory = 1'000;
+
+    const auto root = std::filesystem::temp_directory_path() / "FileHashIndex Benchmark";
+    const auto indexFile = std::filesystem::temp_directory_path() / "FileHashIndex Benchmark.index";
+    std::filesystem::remove_all(root);
+
+    const auto measure = [](const auto &aRun) {
+        const auto start = std::chrono::steady_clock::now();
+        aRun();
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        return duration.count() * 1'000;
+    };
+
+    const auto writeMilliseconds = measure([&] {
+        for (size_t i = 0; i < directoriesCount; i++)
+        {
+            const auto directory = root / std::to_string(i);
+            std::filesystem::create_directories(directory);
+            for (size_t j = 0; j < filesPerDirectory; j++)
+            {
+                std::ofstream(directory / (std::to_string(j) + ".txt")) << i << ' ' << j;
+            }
+        }
+    });
+    std::cout << directoriesCount * filesPerDirectory << " files written in " << writeMilliseconds << " ms"
+              << std::endl;
+
+    FileHashIndex::Changes changes;
+    {
+        FileHashIndex index;
+        const auto coldMilliseconds = measure([&] { changes = index.Scan(root); });
+        std::cout << "cold scan: " << coldMilliseconds << " ms, " << changes.hashedCount << " hashed, "
+                  << changes.added.size() << " added" << std::endl;
+
+        const auto saveMilliseconds = measure([&] { index.Save(indexFile); });
+        std::cout << "saved in " << saveMilliseconds << " ms, " << std::filesystem::file_size(indexFile) << " B"
+                  << std::endl;
+    }
+
+    FileHashIndex index;
+    const auto loadMilliseconds = measure([&] { index.Load(indexFile); });
+    const auto warmMilliseconds = measure([&] { changes = index.Scan(root); });
+    std::cout << "loaded in " << loadMilliseconds << " ms, warm scan: " << warmMilliseconds << " ms, "
+              << changes.hashedCount << " hashed, "
+              << changes.added.size() + changes.removed.size() + changes.modified.size() << " changes" << std::endl;
+
+    std::ofstream(root / "0" / "new.txt") << "new";
+    std::filesystem::remove(root / "1" / "1.txt");
+    std::ofstream(root / "2" / "2.txt", std::ios::app) << " modified";
+    std::ofstream(root / "3" / "3.txt") << 3 << ' ' << 3; // the same contents
+
+    changes = index.Scan(root);
+    std::cout << changes.hashedCount << " hashed, added:";
+    for (const auto &path : changes.added)
+    {
+        std::cout << ' ' << path;
+    }
+    std::cout << ", removed:";
+    for (const auto &path : changes.removed)
+    {
+        std::cout << ' ' << path;
+    }
+    std::cout << ", modified:";
+    for (const auto &path : changes.modified)
+    {
+        std::cout << ' ' << path;
+    }
+    std::cout << std::endl;
+
+    std::filesystem::remove_all(root);
+    std::filesystem::remove(indexFile);
+}
+
+int main()
+{
+    BenchmarkRescan();
+
+    return 0;
+}
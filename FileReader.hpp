@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <semaphore>
+#include <span>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FILE_READER_POSIX 1
+#else
+#define FILE_READER_POSIX 0
+#endif
+
+// feeds a whole file, in order, to aConsumer(std::span<const uint8_t>) without the copies of a std::ifstream
+class FileReader
+{
+  public:
+    enum class Mode : uint8_t
+    {
+        MAP,   // mmap with sequential read-ahead, READ if the file can not be mapped, is small or too large
+        READ,  // pread into two buffers, the next one filled on a second thread while the consumer runs, read for pipes
+        STREAM // std::ifstream, the only one off POSIX
+    };
+
+    static constexpr uint64_t CHUNK_SIZE = 1 << 20;
+
+    // aConsumer must not throw, false if the file could not be opened or read
+    template <typename Consumer>
+    static bool Read(const std::filesystem::path &aFile, Consumer &&aConsumer, const Mode aMode = Mode::MAP,
+                     const uint64_t aChunkSize = CHUNK_SIZE)
+    {
+#if FILE_READER_POSIX
+        if (aMode != Mode::STREAM)
+        {
+            const Descriptor file{open(aFile.c_str(), O_RDONLY | O_CLOEXEC)};
+            if (file.descriptor < 0)
+            {
+                return false;
+            }
+
+            if (aMode == Mode::MAP && Map(file.descriptor, aConsumer))
+            {
+                return true;
+            }
+
+            return ReadAhead(file.descriptor, aConsumer, aChunkSize);
+        }
+#endif // FILE_READER_POSIX
+
+        return Stream(aFile, aConsumer, aChunkSize);
+    }
+
+  private:
+    template <typename Consumer>
+    static bool Stream(const std::filesystem::path &aFile, Consumer &aConsumer, const uint64_t aChunkSize)
+    {
+        std::ifstream ifs(aFile, std::ios::binary);
+        if (!ifs)
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> buffer(aChunkSize);
+        while (ifs.read(reinterpret_cast<char *>(buffer.data()), buffer.size()) || ifs.gcount())
+        {
+            aConsumer(std::span<const uint8_t>(buffer.data(), static_cast<size_t>(ifs.gcount())));
+        }
+
+        return ifs.eof();
+    }
+
+#if FILE_READER_POSIX
+    static constexpr off_t MAP_SIZE_MIN = 64 << 10;
+    static constexpr size_t MAP_WINDOW = 64 << 20;
+
+    // half the memory
+    static inline const uint64_t sMapSizeMax =
+        static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE)) / 2;
+
+    struct Descriptor
+    {
+        int descriptor;
+
+        ~Descriptor()
+        {
+            if (descriptor >= 0)
+            {
+                close(descriptor);
+            }
+        }
+    };
+
+    // only the regular files, the others (pipes, /proc) are read, truncating a mapped file raises SIGBUS, a small file
+    // reads faster than it maps and the page faults make the files that do not fit in the page cache slower than read
+    template <typename Consumer> static bool Map(const int aFile, Consumer &aConsumer)
+    {
+        struct stat status;
+        if (fstat(aFile, &status) || !S_ISREG(status.st_mode) || status.st_size < MAP_SIZE_MIN ||
+            static_cast<uint64_t>(status.st_size) > sMapSizeMax)
+        {
+            return false;
+        }
+
+        const auto size = static_cast<size_t>(status.st_size);
+        auto *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, aFile, 0);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        // the kernel is asked for the next window while the consumer runs through this one
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        madvise(data, size, MADV_SEQUENTIAL);
+        for (size_t offset = 0; offset < size; offset += MAP_WINDOW)
+        {
+            const auto next = offset + MAP_WINDOW;
+            if (next < size)
+            {
+                madvise(const_cast<uint8_t *>(bytes) + next, std::min(MAP_WINDOW, size - next), MADV_WILLNEED);
+            }
+            aConsumer(std::span<const uint8_t>(bytes + offset, std::min(MAP_WINDOW, size - offset)));
+        }
+
+        munmap(data, size);
+        return true;
+    }
+
+    // fills aBuffer unless the file ends first, the size read or -1, a pipe or a socket is read on from where it is
+    static ssize_t ReadFully(const int aFile, std::vector<uint8_t> &aBuffer, const off_t aOffset, const bool aSeekable)
+    {
+        size_t size{};
+        while (size < aBuffer.size())
+        {
+            const auto count = aSeekable ? pread(aFile, aBuffer.data() + size, aBuffer.size() - size, aOffset + size)
+                                         : read(aFile, aBuffer.data() + size, aBuffer.size() - size);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (count < 0)
+            {
+                return -1;
+            }
+
+            if (!count)
+            {
+                break;
+            }
+
+            size += count;
+        }
+
+        return size;
+    }
+
+    template <typename Consumer> static bool ReadAhead(const int aFile, Consumer &aConsumer, const uint64_t aChunkSize)
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(aFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // POSIX_FADV_SEQUENTIAL
+
+        // pread fails with ESPIPE on the files that can not seek
+        const auto seekable = lseek(aFile, 0, SEEK_CUR) >= 0;
+
+        // a file within a chunk is not worth the second thread, one byte more to see its end in a single read
+        struct stat status;
+        if (!fstat(aFile, &status) && S_ISREG(status.st_mode) && static_cast<uint64_t>(status.st_size) < aChunkSize)
+        {
+            std::vector<uint8_t> buffer(
+                std::min(std::max<uint64_t>(status.st_size + 1, 4096), std::max<uint64_t>(aChunkSize, 4096)));
+
+            ssize_t size;
+            for (off_t offset = 0; (size = ReadFully(aFile, buffer, offset, seekable)) > 0; offset += size)
+            {
+                aConsumer(std::span<const uint8_t>(buffer.data(), static_cast<size_t>(size)));
+            }
+
+            return !size;
+        }
+
+        std::array<std::vector<uint8_t>, 2> buffers{std::vector<uint8_t>(aChunkSize), std::vector<uint8_t>(aChunkSize)};
+        std::array<ssize_t, 2> sizes{};
+
+        // the reader fills the free buffers, the consumer empties the ready ones, in turns
+        std::counting_semaphore<2> free(2);
+        std::counting_semaphore<2> ready(0);
+
+        std::thread reader([&] {
+            off_t offset{};
+            for (size_t i = 0;; i++)
+            {
+                free.acquire();
+                const auto size = sizes[i % 2] = ReadFully(aFile, buffers[i % 2], offset, seekable);
+                ready.release();
+
+                // the end, or an error
+                if (size <= 0)
+                {
+                    return;
+                }
+                offset += size;
+            }
+        });
+
+        ssize_t size{};
+        for (size_t i = 0;; i++)
+        {
+            ready.acquire();
+            size = sizes[i % 2];
+            if (size <= 0)
+            {
+                break;
+            }
+
+            aConsumer(std::span<const uint8_t>(buffers[i % 2].data(), static_cast<size_t>(size)));
+            free.release();
+        }
+
+        reader.join();
+        return !size;
+    }
+#endif // FILE_READER_POSIX
+};
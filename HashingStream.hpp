@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#define HASHING_STREAM_POSIX 1
+#else
+#define HASHING_STREAM_POSIX 0
+#endif
+
+// tees what goes through another std::streambuf into a Hasher with Update(std::span<const uint8_t>), XXHash64 or
+// CRC64::Hasher, the large writes go to the inner buffer straight from the caller's memory and the large reads come
+// straight into it, each hashed there, the small ones go through a buffer, the writes hashed as it is flushed and the
+// reads as it is filled, possibly ahead of what the caller took but never past what the inner buffer has at hand
+template <typename Hasher> class HashingStreambuf : public std::streambuf
+{
+  public:
+    static constexpr size_t BUFFER_SIZE = 64 << 10;
+
+  public:
+    HashingStreambuf(std::streambuf *aInner, Hasher aHasher) : mInner(aInner), mHasher(std::move(aHasher))
+    {
+    }
+
+    ~HashingStreambuf() override
+    {
+        Flush();
+    }
+
+    const Hasher &GetHasher() const noexcept
+    {
+        return mHasher;
+    }
+
+    auto Digest() const noexcept
+    {
+        return mHasher.Digest();
+    }
+
+  protected:
+    int_type overflow(const int_type aChar) override
+    {
+        if (!Flush())
+        {
+            return traits_type::eof();
+        }
+
+        if (traits_type::eq_int_type(aChar, traits_type::eof()))
+        {
+            return traits_type::not_eof(aChar);
+        }
+
+        if (mPutBuffer.empty())
+        {
+            mPutBuffer.resize(BUFFER_SIZE);
+            setp(mPutBuffer.data(), mPutBuffer.data() + mPutBuffer.size());
+        }
+
+        *pptr() = traits_type::to_char_type(aChar);
+        pbump(1);
+        return aChar;
+    }
+
+    // what the buffer holds first, the large writes after it with no copy
+    std::streamsize xsputn(const char_type *aData, const std::streamsize aSize) override
+    {
+        if (aSize < epptr() - pptr())
+        {
+            std::memcpy(pptr(), aData, static_cast<size_t>(aSize));
+            pbump(static_cast<int>(aSize));
+            return aSize;
+        }
+
+        if (!Flush())
+        {
+            return 0;
+        }
+
+        const auto size = mInner->sputn(aData, aSize);
+        Hash(aData, size);
+        return size;
+    }
+
+    // waits for one character only, then takes what came with it, a short line from a pipe or a socket is not held
+    // back until the buffer fills up or the peer closes
+    int_type underflow() override
+    {
+        if (gptr() == egptr())
+        {
+            mGetBuffer.resize(BUFFER_SIZE);
+
+            std::streamsize size{};
+            if (!traits_type::eq_int_type(mInner->sgetc(), traits_type::eof()))
+            {
+                const auto available = std::clamp<std::streamsize>(mInner->in_avail(), 1, BUFFER_SIZE);
+                size = mInner->sgetn(mGetBuffer.data(), available);
+            }
+            Hash(mGetBuffer.data(), size);
+            setg(mGetBuffer.data(), mGetBuffer.data(), mGetBuffer.data() + std::max<std::streamsize>(size, 0));
+        }
+
+        return gptr() == egptr() ? traits_type::eof() : traits_type::to_int_type(*gptr());
+    }
+
+    // what the buffer holds, hashed already, then the rest with no copy, waiting for all of it like the inner sgetn as
+    // std::istream::read takes a short count for the end of the file
+    std::streamsize xsgetn(char_type *aData, const std::streamsize aSize) override
+    {
+        const auto buffered = std::min<std::streamsize>(egptr() - gptr(), aSize);
+        std::memcpy(aData, gptr(), static_cast<size_t>(buffered));
+        gbump(static_cast<int>(buffered));
+
+        if (buffered == aSize)
+        {
+            return buffered;
+        }
+
+        const auto size = mInner->sgetn(aData + buffered, aSize - buffered);
+        Hash(aData + buffered, size);
+        return buffered + std::max<std::streamsize>(size, 0);
+    }
+
+    int sync() override
+    {
+        return Flush() ? mInner->pubsync() : -1;
+    }
+
+  private:
+    // false if the inner buffer took only part of it, the rest is dropped
+    bool Flush()
+    {
+        const auto size = pptr() - pbase();
+        const auto written = size ? mInner->sputn(pbase(), size) : 0;
+        Hash(pbase(), written);
+        setp(mPutBuffer.data(), mPutBuffer.data() + mPutBuffer.size());
+
+        return written == size;
+    }
+
+    void Hash(const char_type *aData, const std::streamsize aSize)
+    {
+        if (aSize > 0)
+        {
+            mHasher.Update({reinterpret_cast<const uint8_t *>(aData), static_cast<size_t>(aSize)});
+        }
+    }
+
+  private:
+    std::streambuf *mInner;
+    Hasher mHasher;
+    std::vector<char_type> mPutBuffer;
+    std::vector<char_type> mGetBuffer;
+};
+
+#if HASHING_STREAM_POSIX
+// read(2) and write(2) on a descriptor it does not own, the bytes they move hashed on the way
+template <typename Hasher> class HashingDescriptor
+{
+  public:
+    HashingDescriptor(const int aDescriptor, Hasher aHasher) : mDescriptor(aDescriptor), mHasher(std::move(aHasher))
+    {
+    }
+
+    ssize_t Read(void *aData, const size_t aSize)
+    {
+        ssize_t size;
+        while ((size = read(mDescriptor, aData, aSize)) < 0 && errno == EINTR)
+        {
+        }
+
+        Hash(aData, size);
+        return size;
+    }
+
+    ssize_t Write(const void *aData, const size_t aSize)
+    {
+        ssize_t size;
+        while ((size = write(mDescriptor, aData, aSize)) < 0 && errno == EINTR)
+        {
+        }
+
+        Hash(aData, size);
+        return size;
+    }
+
+    // until the end of the file or an error, the size read or -1
+    ssize_t ReadFully(void *aData, const size_t aSize)
+    {
+        size_t size{};
+        while (size < aSize)
+        {
+            const auto count = Read(static_cast<uint8_t *>(aData) + size, aSize - size);
+            if (count < 0)
+            {
+                return -1;
+            }
+
+            if (!count)
+            {
+                break;
+            }
+
+            size += count;
+        }
+
+        return size;
+    }
+
+    // false on an error, a short write is carried on
+    bool WriteFully(const void *aData, const size_t aSize)
+    {
+        for (size_t size = 0; size < aSize;)
+        {
+            const auto count = Write(static_cast<const uint8_t *>(aData) + size, aSize - size);
+            if (count < 0)
+            {
+                return false;
+            }
+
+            size += count;
+        }
+
+        return true;
+    }
+
+    const Hasher &GetHasher() const noexcept
+    {
+        return mHasher;
+    }
+
+    auto Digest() const noexcept
+    {
+        return mHasher.Digest();
+    }
+
+  private:
+    void Hash(const void *aData, const ssize_t aSize)
+    {
+        if (aSize > 0)
+        {
+            mHasher.Update({static_cast<const uint8_t *>(aData), static_cast<size_t>(aSize)});
+        }
+    }
+
+  private:
+    int mDescriptor;
+    Hasher mHasher;
+};
+#endif // HASHING_STREAM_POSIX
@@ -1,8 +1,31 @@
+#include "XXHash64.hpp"
+
 #include <iostream>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <new>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define INI_X86_SIMD 1
+#else
+#define INI_X86_SIMD 0
+#endif
 
 class IniException final : public std::exception
 {
@@ -35,24 +58,39 @@ typedef struct IniContext_s
 class IniHelper final
 {
   public:
-    IniHelper(const IniContext &aContext) noexcept : mContext(aContext)
+    IniHelper(const IniContext &aContext) noexcept
+    {
+        for (const auto space : aContext.spaces)
+        {
+            mSpaces[static_cast<uint8_t>(space)] = true;
+        }
+    }
+
+    bool IsSpace(const char aChar) const noexcept
     {
+        return mSpaces[static_cast<uint8_t>(aChar)];
     }
 
-    std::string Trim(const std::string &aString) const noexcept
+    // an empty one still points into aString, at its end
+    std::string_view Trim(const std::string_view aString) const noexcept
     {
-        const auto first = aString.find_first_not_of(mContext.spaces);
-        if (first == std::string::npos)
+        size_t first = 0;
+        size_t last = aString.size();
+        while (first < last && IsSpace(aString[first]))
+        {
+            first++;
+        }
+
+        while (last > first && IsSpace(aString[last - 1]))
         {
-            return {};
+            last--;
         }
 
-        const auto last = aString.find_last_not_of(mContext.spaces);
-        return aString.substr(first, last - first + 1);
+        return aString.substr(first, last - first);
     }
 
   private:
-    IniContext mContext;
+    std::array<bool, 256> mSpaces{};
 };
 
 class IniLexer final
@@ -66,11 +104,81 @@ class IniLexer final
         PAIR
     };
 
+    enum class Simd : uint8_t
+    {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    // the kernel of Scan, the best one supported is picked at startup, for tests and benchmarks
+    static Simd GetSimd() noexcept
+    {
+        return sSimd;
+    }
+
+    static bool SetSimd(const Simd aSimd) noexcept
+    {
+        if (aSimd > DetectSimd())
+        {
+            return false;
+        }
+
+        sSimd = aSimd;
+        return true;
+    }
+
+  public:
     explicit IniLexer(const IniContext &aContext = {}) noexcept : mContext(aContext), mHelper(aContext)
     {
+        for (const auto commentStart : mContext.commentsStart)
+        {
+            mComments[static_cast<uint8_t>(commentStart)] = true;
+        }
+    }
+
+    // every line of aData, which is split on line feeds, to aConsumer(Token, std::string_view, std::string_view) in
+    // one pass, the name of a section, the key and value of a pair or else the trimmed line, the empty lines skipped,
+    // as FindToken and the Parse*View would tell
+    template <typename Consumer> void Scan(const std::string_view aData, Consumer &&aConsumer) const
+    {
+#if INI_X86_SIMD
+        if (sSimd != Simd::SCALAR)
+        {
+            return ScanBlocks(aData, aConsumer);
+        }
+#endif // INI_X86_SIMD
+
+        // a line at a time, the masks made a byte at a time are slower
+        for (size_t begin = 0; begin < aData.size();)
+        {
+            const auto end = std::min(aData.find('\n', begin), aData.size());
+            const auto line = mHelper.Trim(aData.substr(begin, end - begin));
+            begin = end + 1;
+
+            if (!line.empty())
+            {
+                const size_t first = line.data() - aData.data();
+                const auto separator = line.find(mContext.pairSeparator);
+                const auto separatorAt = separator == std::string_view::npos ? separator : first + separator;
+                Emit(aData, {first, first + line.size() - 1, separatorAt}, aConsumer);
+            }
+        }
+    }
+
+    std::string ParseSection(const std::string_view aLine) const
+    {
+        return std::string(ParseSectionView(aLine));
+    }
+
+    std::pair<std::string, std::string> ParsePair(const std::string_view aLine) const
+    {
+        const auto [key, value] = ParsePairView(aLine);
+        return {std::string(key), std::string(value)};
     }
 
-    std::string ParseSection(std::string aLine) const
+    // the same as views into aLine
+    std::string_view ParseSectionView(std::string_view aLine) const
     {
         if (!IsSection(aLine))
         {
@@ -78,11 +186,10 @@ class IniLexer final
         }
 
         aLine = mHelper.Trim(aLine);
-        const auto section(aLine.substr(1, aLine.size() - 2));
-        return mHelper.Trim(section);
+        return mHelper.Trim(aLine.substr(1, aLine.size() - 2));
     }
 
-    std::pair<std::string, std::string> ParsePair(std::string aLine) const
+    std::pair<std::string_view, std::string_view> ParsePairView(std::string_view aLine) const
     {
         if (!IsPair(aLine))
         {
@@ -92,11 +199,7 @@ class IniLexer final
         aLine = mHelper.Trim(aLine);
 
         const auto pos = aLine.find(mContext.pairSeparator);
-
-        const auto key = aLine.substr(0, pos);
-        const auto value = aLine.substr(pos + 1);
-
-        return {mHelper.Trim(key), mHelper.Trim(value)};
+        return {mHelper.Trim(aLine.substr(0, pos)), mHelper.Trim(aLine.substr(pos + 1))};
     }
 
     std::string FormatSection(const std::string &aSection) const noexcept
@@ -109,7 +212,7 @@ class IniLexer final
         return aKey + mContext.pairSeparator + aValue;
     }
 
-    Token FindToken(const std::string &aLine) const noexcept
+    Token FindToken(const std::string_view aLine) const noexcept
     {
         if (IsComment(aLine))
         {
@@ -129,27 +232,245 @@ class IniLexer final
         return Token::NONE;
     }
 
+  private:
+    // where the line being scanned is, in aData
+    struct Line
+    {
+        size_t first = std::string_view::npos;
+        size_t last = std::string_view::npos;
+        size_t separator = std::string_view::npos;
+    };
+
+    template <typename Consumer>
+    void Emit(const std::string_view aData, const Line &aLine, Consumer &aConsumer) const
+    {
+        if (aLine.first == std::string_view::npos)
+        {
+            return;
+        }
+
+        const auto line = aData.substr(aLine.first, aLine.last - aLine.first + 1);
+        if (mComments[static_cast<uint8_t>(line.front())])
+        {
+            aConsumer(Token::COMMENT, line, std::string_view());
+        }
+        else if (line.front() == mContext.sectionStart && line.back() == mContext.sectionEnd)
+        {
+            aConsumer(Token::SECTION, mHelper.Trim(line.substr(1, line.size() - 2)), std::string_view());
+        }
+        else if (aLine.separator <= aLine.last)
+        {
+            const auto separator = aLine.separator - aLine.first;
+            aConsumer(Token::PAIR, mHelper.Trim(line.substr(0, separator)), mHelper.Trim(line.substr(separator + 1)));
+        }
+        else
+        {
+            aConsumer(Token::NONE, line, std::string_view());
+        }
+    }
+
+#if INI_X86_SIMD
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t BLOCKS_COUNT = 64;
+
+    // a bit per byte of a block
+    struct Masks
+    {
+        uint64_t newlines;
+        uint64_t separators;
+        uint64_t texts; // not a space
+    };
+
+    // the line feeds, separators and spaces of 4 KiB at a time in bit masks of a block of 64 bytes, a piece of a line
+    // is then a few bit operations
+    template <typename Consumer> void ScanBlocks(const std::string_view aData, Consumer &aConsumer) const
+    {
+        std::array<Masks, BLOCKS_COUNT> masks;
+
+        Line line;
+        for (size_t offset = 0; offset < aData.size(); offset += BLOCK_SIZE * BLOCKS_COUNT)
+        {
+            const auto count = Classify(aData, offset, masks);
+            for (size_t i = 0; i < count; i++)
+            {
+                ScanBlock(aData, offset + i * BLOCK_SIZE, masks[i], line, aConsumer);
+            }
+        }
+
+        Emit(aData, line, aConsumer);
+    }
+
+    // the pieces of the lines in the block, each up to a line feed or the end of the block
+    template <typename Consumer>
+    void ScanBlock(const std::string_view aData, const size_t aOffset, const Masks &aMasks, Line &aLine,
+                   Consumer &aConsumer) const
+    {
+        auto newlines = aMasks.newlines;
+        for (size_t begin = 0;; begin++)
+        {
+            const size_t end = newlines ? std::countr_zero(newlines) : BLOCK_SIZE;
+            const auto below = end < BLOCK_SIZE ? (1ULL << end) - 1 : ~0ULL;
+            const auto piece = begin < BLOCK_SIZE ? below & ~0ULL << begin : 0;
+
+            const auto texts = aMasks.texts & piece;
+            if (texts)
+            {
+                if (aLine.first == std::string_view::npos)
+                {
+                    aLine.first = aOffset + std::countr_zero(texts);
+                }
+                aLine.last = aOffset + BLOCK_SIZE - 1 - std::countl_zero(texts);
+            }
+
+            // the first separator of the trimmed line
+            if (aLine.first != std::string_view::npos && aLine.separator == std::string_view::npos)
+            {
+                const auto separators = aMasks.separators & piece & ~0ULL << (std::max(aLine.first, aOffset) - aOffset);
+                if (separators)
+                {
+                    aLine.separator = aOffset + std::countr_zero(separators);
+                }
+            }
+
+            if (!newlines)
+            {
+                return;
+            }
+
+            Emit(aData, aLine, aConsumer);
+            aLine = {};
+            begin = end;
+            newlines &= newlines - 1;
+        }
+    }
+
+    // the blocks from aOffset on, the last one of aData through a copy padded with zeros that the masks leave out
+    size_t Classify(const std::string_view aData, const size_t aOffset,
+                    std::array<Masks, BLOCKS_COUNT> &aMasks) const noexcept
+    {
+        const auto count = std::min((aData.size() - aOffset) / BLOCK_SIZE, BLOCKS_COUNT);
+        Classify(aData.data() + aOffset, count, aMasks.data());
+
+        const auto rest = aData.size() - aOffset - count * BLOCK_SIZE;
+        if (count == BLOCKS_COUNT || !rest)
+        {
+            return count;
+        }
+
+        std::array<char, BLOCK_SIZE> block{};
+        std::copy(aData.end() - rest, aData.end(), block.begin());
+        Classify(block.data(), 1, &aMasks[count]);
+
+        const auto valid = (1ULL << rest) - 1;
+        aMasks[count].newlines &= valid;
+        aMasks[count].separators &= valid;
+        aMasks[count].texts &= valid;
+        return count + 1;
+    }
+
+    void Classify(const char *aBlocks, const size_t aCount, Masks *aMasks) const noexcept
+    {
+        if (sSimd == Simd::AVX512)
+        {
+            ClassifyAvx512(aBlocks, aCount, mContext.pairSeparator, mContext.spaces, aMasks);
+        }
+        else
+        {
+            ClassifyAvx2(aBlocks, aCount, mContext.pairSeparator, mContext.spaces, aMasks);
+        }
+    }
+
+    __attribute__((target("avx2"))) static uint64_t MaskAvx2(const __m256i aLow, const __m256i aHigh,
+                                                            const char aChar) noexcept
+    {
+        const auto chars = _mm256_set1_epi8(aChar);
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(aLow, chars))) |
+               static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(aHigh, chars))))
+                   << 32;
+    }
+
+    __attribute__((target("avx2"))) static void ClassifyAvx2(const char *aBlocks, const size_t aCount,
+                                                            const char aSeparator, const std::string_view aSpaces,
+                                                            Masks *aMasks) noexcept
+    {
+        for (size_t i = 0; i < aCount; i++)
+        {
+            const auto *block = aBlocks + i * BLOCK_SIZE;
+            const auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+            const auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+
+            uint64_t spaces{};
+            for (const auto space : aSpaces)
+            {
+                spaces |= MaskAvx2(low, high, space);
+            }
+
+            aMasks[i] = {MaskAvx2(low, high, '\n'), MaskAvx2(low, high, aSeparator), ~spaces};
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) static void ClassifyAvx512(const char *aBlocks, const size_t aCount,
+                                                                          const char aSeparator,
+                                                                          const std::string_view aSpaces,
+                                                                          Masks *aMasks) noexcept
+    {
+        const auto newline = _mm512_set1_epi8('\n');
+        const auto separator = _mm512_set1_epi8(aSeparator);
+        for (size_t i = 0; i < aCount; i++)
+        {
+            const auto block = _mm512_loadu_si512(aBlocks + i * BLOCK_SIZE);
+
+            uint64_t spaces{};
+            for (const auto space : aSpaces)
+            {
+                spaces |= _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(space));
+            }
+
+            aMasks[i] = {_mm512_cmpeq_epi8_mask(block, newline), _mm512_cmpeq_epi8_mask(block, separator), ~spaces};
+        }
+    }
+#endif // INI_X86_SIMD
+
+    static Simd DetectSimd() noexcept
+    {
+#if INI_X86_SIMD
+        if (__builtin_cpu_supports("avx512bw"))
+        {
+            return Simd::AVX512;
+        }
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Simd::AVX2;
+        }
+#endif // INI_X86_SIMD
+
+        return Simd::SCALAR;
+    }
+
+    static inline Simd sSimd = DetectSimd();
+
   private:
     IniContext mContext;
     IniHelper mHelper;
+    std::array<bool, 256> mComments{};
 
-    bool IsSection(std::string aLine) const noexcept
+    bool IsSection(std::string_view aLine) const noexcept
     {
         aLine = mHelper.Trim(aLine);
-        return aLine.front() == mContext.sectionStart && aLine.back() == mContext.sectionEnd;
+        return !aLine.empty() && aLine.front() == mContext.sectionStart && aLine.back() == mContext.sectionEnd;
     }
 
-    bool IsPair(std::string aLine) const noexcept
+    bool IsPair(const std::string_view aLine) const noexcept
     {
-        aLine = mHelper.Trim(aLine);
-        return aLine.find(mContext.pairSeparator) != std::string::npos;
+        return mHelper.Trim(aLine).find(mContext.pairSeparator) != std::string_view::npos;
     }
 
-    bool IsComment(const std::string &aLine) const noexcept
+    bool IsComment(const std::string_view aLine) const noexcept
     {
         for (const auto commentStart : mContext.commentsStart)
         {
-            if (aLine.front() == commentStart)
+            if (!aLine.empty() && aLine.front() == commentStart)
             {
                 return true;
             }
@@ -162,15 +483,18 @@ class IniLexer final
 class IniParser final
 {
   public:
-    using Section = std::map<std::string, std::string>;
+    using Section = std::map<std::string, std::string, std::less<>>;
 
     explicit IniParser(const IniContext &aContext = IniContext()) noexcept
         : mContext(aContext), mHelper(mContext), mLexer(mContext)
     {
     }
 
+    // a frozen parser thaws, its pairs may change
     void Deserialize(std::ifstream &aStream)
     {
+        Thaw();
+
         std::string sectionLast;
 
         std::string line;
@@ -227,16 +551,590 @@ class IniParser final
         return mSections.at(aSection).at(aKey);
     }
 
+    // Get through the frozen table if there is one, with no std::string built for the lookup, std::out_of_range if
+    // there is no such pair, the value lives until the next Deserialize or Freeze
+    std::string_view GetView(const std::string_view aSection, const std::string_view aKey) const
+    {
+        if (!mSlots.empty())
+        {
+            return GetFrozen(aSection, aKey);
+        }
+
+        const auto section = mSections.find(aSection);
+        if (section != mSections.end())
+        {
+            const auto pair = section->second.find(aKey);
+            if (pair != section->second.end())
+            {
+                return pair->second;
+            }
+        }
+
+        throw std::out_of_range("No such section or key!");
+    }
+
+    // GetView from a single hash table over every pair until the next Deserialize rather than through the two maps
+    void Freeze()
+    {
+        size_t size{};
+        for (const auto &[name, section] : mSections)
+        {
+            for (const auto &[key, value] : section)
+            {
+                size += name.size() + key.size() + value.size();
+            }
+        }
+
+        if (size > UINT32_MAX)
+        {
+            throw std::length_error("Too many pairs to freeze!");
+        }
+
+        mPairs.clear();
+        mArena.clear();
+        mArena.reserve(size);
+        for (const auto &[name, section] : mSections)
+        {
+            for (const auto &[key, value] : section)
+            {
+                mPairs.push_back({static_cast<uint32_t>(mArena.size()), static_cast<uint32_t>(name.size()),
+                                  static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size())});
+                mArena.append(name).append(key).append(value);
+            }
+        }
+
+        // half full at most
+        mSlots.assign(std::bit_ceil(std::max<size_t>(mPairs.size() * 2, 2)), {});
+        for (uint32_t i = 0; i < mPairs.size(); i++)
+        {
+            const auto hash = Hash(SectionOf(mPairs[i]), KeyOf(mPairs[i]));
+            auto slot = static_cast<size_t>(hash) & (mSlots.size() - 1);
+            while (mSlots[slot].index)
+            {
+                slot = (slot + 1) & (mSlots.size() - 1);
+            }
+
+            mSlots[slot] = {static_cast<uint32_t>(hash >> 32), i + 1};
+        }
+    }
+
+    void Thaw() noexcept
+    {
+        mArena.clear();
+        mPairs.clear();
+        mSlots.clear();
+    }
+
+  private:
+    // the section, the key and the value one after the other in the arena, so one line of cache holds most of them
+    struct Pair
+    {
+        uint32_t offset;
+        uint32_t sectionSize;
+        uint32_t keySize;
+        uint32_t valueSize;
+    };
+
+    // the high half of the hash saves a look at the pair on most of the other pairs met, 0 is no pair
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    // seeded with the size of the section so that the same bytes split differently hash differently
+    static uint64_t Hash(const std::string_view aSection, const std::string_view aKey) noexcept
+    {
+        XXHash64 hasher(aSection.size());
+        hasher.Update({reinterpret_cast<const uint8_t *>(aSection.data()), aSection.size()});
+        hasher.Update({reinterpret_cast<const uint8_t *>(aKey.data()), aKey.size()});
+        return hasher.Digest();
+    }
+
+    std::string_view SectionOf(const Pair &aPair) const noexcept
+    {
+        return {mArena.data() + aPair.offset, aPair.sectionSize};
+    }
+
+    std::string_view KeyOf(const Pair &aPair) const noexcept
+    {
+        return {mArena.data() + aPair.offset + aPair.sectionSize, aPair.keySize};
+    }
+
+    std::string_view ValueOf(const Pair &aPair) const noexcept
+    {
+        return {mArena.data() + aPair.offset + aPair.sectionSize + aPair.keySize, aPair.valueSize};
+    }
+
+    std::string_view GetFrozen(const std::string_view aSection, const std::string_view aKey) const
+    {
+        const auto hash = Hash(aSection, aKey);
+        for (auto slot = static_cast<size_t>(hash) & (mSlots.size() - 1); mSlots[slot].index;
+             slot = (slot + 1) & (mSlots.size() - 1))
+        {
+            if (mSlots[slot].hash != static_cast<uint32_t>(hash >> 32))
+            {
+                continue;
+            }
+
+            const auto &pair = mPairs[mSlots[slot].index - 1];
+            if (SectionOf(pair) == aSection && KeyOf(pair) == aKey)
+            {
+                return ValueOf(pair);
+            }
+        }
+
+        throw std::out_of_range("No such section or key!");
+    }
+
   private:
-    std::map<std::string, Section> mSections;
+    std::map<std::string, Section, std::less<>> mSections;
+
+    // the frozen pairs own their bytes, a copy of the parser is frozen as well
+    std::string mArena;
+    std::vector<Pair> mPairs;
+    std::vector<Slot> mSlots;
 
     IniContext mContext;
     IniHelper mHelper;
     IniLexer mLexer;
 };
 
+// the whole file in one buffer that the sections, keys and values point into, the lines are parsed with no allocation,
+// only the arrays of pairs and sections grow, the pairs under each section line are then sorted by key and the
+// sections by name, a section found on several lines is searched from the last, the last value of a key wins as in
+// IniParser
+class IniView final
+{
+  public:
+    struct Pair
+    {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    explicit IniView(const IniContext &aContext = IniContext()) noexcept : mLexer(aContext)
+    {
+    }
+
+    // the views point into this one
+    IniView(const IniView &) = delete;
+    IniView &operator=(const IniView &) = delete;
+
+    // false if the file could not be read
+    bool Load(const std::filesystem::path &aFile)
+    {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(aFile, error);
+        if (error)
+        {
+            return false;
+        }
+
+        std::string data(size, '\0');
+        std::ifstream ifs(aFile, std::ios::binary);
+        if (!ifs.read(data.data(), static_cast<std::streamsize>(data.size())))
+        {
+            return false;
+        }
+
+        Parse(std::move(data));
+        return true;
+    }
+
+    void Parse(std::string aData)
+    {
+        mData = std::move(aData);
+        mPairs.clear();
+        mPairs.reserve(std::ranges::count(mData, '\n') + 1);
+        mSections.assign(1, {});
+
+        mLexer.Scan(mData, [this](const IniLexer::Token aToken, const std::string_view aFirst,
+                                  const std::string_view aSecond) {
+            switch (aToken)
+            {
+            case IniLexer::Token::SECTION:
+                mSections.back().end = mPairs.size();
+                mSections.push_back({aFirst, mPairs.size(), {}});
+                break;
+
+            case IniLexer::Token::PAIR:
+                mPairs.push_back({aFirst, aSecond});
+                break;
+
+            case IniLexer::Token::COMMENT:
+            case IniLexer::Token::NONE:
+            default:
+                break;
+            }
+        });
+        mSections.back().end = mPairs.size();
+
+        // in the order of the file among the same keys and sections, which std::stable_sort would allocate for
+        for (const auto &section : mSections)
+        {
+            std::ranges::sort(Pairs(section), [](const Pair &aLeft, const Pair &aRight) {
+                return aLeft.key != aRight.key ? aLeft.key < aRight.key
+                                               : std::less<>()(aLeft.value.data(), aRight.value.data());
+            });
+        }
+        std::ranges::sort(mSections, [](const Section &aLeft, const Section &aRight) {
+            return aLeft.name != aRight.name ? aLeft.name < aRight.name : aLeft.begin < aRight.begin;
+        });
+    }
+
+    std::string_view Get(const std::string_view aSection, const std::string_view aKey) const
+    {
+        const auto [first, last] = std::ranges::equal_range(mSections, aSection, {}, &Section::name);
+        for (auto it = last; it != first;)
+        {
+            const auto pairs = Pairs(*--it);
+            const auto found = std::ranges::upper_bound(pairs, aKey, {}, &Pair::key);
+            if (found != pairs.begin() && std::prev(found)->key == aKey)
+            {
+                return std::prev(found)->value;
+            }
+        }
+
+        throw std::out_of_range("No such section or key!");
+    }
+
+    // the pairs read, the repeated keys included
+    size_t Size() const noexcept
+    {
+        return mPairs.size();
+    }
+
+  private:
+    // the pairs under a section line, the first one under no section, up to the next line
+    struct Section
+    {
+        std::string_view name;
+        size_t begin;
+        size_t end;
+    };
+
+    std::span<Pair> Pairs(const Section &aSection) noexcept
+    {
+        return std::span(mPairs).subspan(aSection.begin, aSection.end - aSection.begin);
+    }
+
+    std::span<const Pair> Pairs(const Section &aSection) const noexcept
+    {
+        return std::span(mPairs).subspan(aSection.begin, aSection.end - aSection.begin);
+    }
+
+  private:
+    std::string mData;
+    std::vector<Pair> mPairs;
+    std::vector<Section> mSections;
+
+    IniLexer mLexer;
+};
+
+// every allocation of the program, for the benchmark
+static size_t sAllocationsCount;
+
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif // _MSC_VER
+
+// out of line, once inlined GCC pairs the malloc or the free inside with the other operator and warns of a mismatch
+NOINLINE void *operator new(const size_t aSize)
+{
+    sAllocationsCount++;
+    if (auto *pointer = std::malloc(aSize ? aSize : 1))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+NOINLINE void operator delete(void *aPointer) noexcept
+{
+    std::free(aPointer);
+}
+
+NOINLINE void operator delete(void *aPointer, size_t) noexcept
+{
+    std::free(aPointer);
+}
+
+// "key<j>" in "Section <i>" is "value of the key <j> in the section <i>"
+std::filesystem::path GenerateIni(const size_t aSectionsCount, const size_t aKeysCount)
+{
+    const auto file = std::filesystem::temp_directory_path() / "IniParser.ini";
+
+    std::ofstream ofs(file, std::ios::binary);
+    for (size_t i = 0; i < aSectionsCount; i++)
+    {
+        ofs << "[Section " << i << "]\n; generated\n";
+        for (size_t j = 0; j < aKeysCount; j++)
+        {
+            ofs << "  key" << j << " = value of the key " << j << " in the section " << i << '\n';
+        }
+        ofs << '\n';
+    }
+
+    return file;
+}
+
+// a generated file of some tens of MB, both parsers on it and then every value of one against the other
+void BenchmarkParsers()
+{
+    constexpr size_t sectionsCount = 20'000;
+    constexpr size_t keysCount = 40;
+
+    const auto file = GenerateIni(sectionsCount, keysCount);
+    const auto linesCount = static_cast<double>(sectionsCount * (keysCount + 3));
+
+    const auto measure = [&](const char *aName, auto &&aParse) {
+        const auto allocationsCount = sAllocationsCount;
+        const auto start = std::chrono::steady_clock::now();
+
+        aParse();
+
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        std::cout << aName << ": " << linesCount / duration.count() / 1'000'000 << " M lines/s, "
+                  << (sAllocationsCount - allocationsCount) / linesCount << " allocations per line" << std::endl;
+    };
+
+    IniParser parser;
+    measure("IniParser", [&] {
+        std::ifstream ifs(file);
+        parser.Deserialize(ifs);
+    });
+
+    IniView view;
+    for (const auto &[simd, name] : {std::pair(IniLexer::Simd::SCALAR, "IniView scalar"),
+                                    std::pair(IniLexer::Simd::AVX2, "IniView avx2"),
+                                    std::pair(IniLexer::Simd::AVX512, "IniView avx512")})
+    {
+        const auto simdBest = IniLexer::GetSimd();
+        if (IniLexer::SetSimd(simd))
+        {
+            measure(name, [&] { view.Load(file); });
+            IniLexer::SetSimd(simdBest);
+        }
+    }
+
+    for (size_t i = 0; i < sectionsCount; i += 997)
+    {
+        const auto section = "Section " + std::to_string(i);
+        for (size_t j = 0; j < keysCount; j++)
+        {
+            const auto key = "key" + std::to_string(j);
+            if (parser.Get(section, key) != view.Get(section, key))
+            {
+                std::cout << "the parsers disagree on " << section << '.' << key << std::endl;
+            }
+        }
+    }
+    if (view.Size() != sectionsCount * keysCount)
+    {
+        std::cout << "the view has " << view.Size() << " pairs" << std::endl;
+    }
+
+    std::filesystem::remove(file);
+}
+
+// random pairs that all exist, looked up in the maps, the frozen table and the view, a large file and a small one
+void BenchmarkLookups(const size_t aSectionsCount, const size_t aKeysCount)
+{
+    constexpr size_t queriesCount = 1 << 16;
+    constexpr size_t roundsCount = 32;
+
+    const auto file = GenerateIni(aSectionsCount, aKeysCount);
+
+    IniParser parser;
+    std::ifstream ifs(file);
+    parser.Deserialize(ifs);
+
+    IniParser frozen;
+    ifs.clear();
+    ifs.seekg(0);
+    frozen.Deserialize(ifs);
+    frozen.Freeze();
+    frozen = IniParser(frozen);
+
+    IniView view;
+    view.Load(file);
+
+    std::vector<std::pair<std::string, std::string>> queries;
+    uint64_t random = 42;
+    for (size_t i = 0; i < queriesCount; i++)
+    {
+        // xorshift
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        queries.emplace_back("Section " + std::to_string(random % aSectionsCount),
+                             "key" + std::to_string((random >> 32) % aKeysCount));
+    }
+
+    std::cout << aSectionsCount << " sections of " << aKeysCount << " keys:" << std::endl;
+    const auto measure = [&](const char *aName, auto &&aGet) {
+        size_t sizes{};
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < roundsCount; i++)
+        {
+            for (const auto &[section, key] : queries)
+            {
+                sizes += aGet(section, key).size();
+            }
+        }
+
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        std::cout << "  " << aName << ": " << queriesCount * roundsCount / duration.count() / 1'000'000
+                  << " M lookups/s (" << sizes << " bytes)" << std::endl;
+    };
+
+    measure("std::map", [&](const std::string_view aSection, const std::string_view aKey) {
+        return parser.GetView(aSection, aKey);
+    });
+    measure("frozen", [&](const std::string_view aSection, const std::string_view aKey) {
+        return frozen.GetView(aSection, aKey);
+    });
+    measure("IniView", [&](const std::string_view aSection, const std::string_view aKey) {
+        return view.Get(aSection, aKey);
+    });
+
+    for (const auto &[section, key] : queries)
+    {
+        if (frozen.GetView(section, key) != parser.Get(section, key))
+        {
+            std::cout << "the frozen parser disagrees on " << section << '.' << key << std::endl;
+        }
+    }
+
+    try
+    {
+        frozen.GetView("Section", "key0");
+        std::cout << "the frozen parser found a pair that is not there" << std::endl;
+    }
+    catch (const std::out_of_range &)
+    {
+    }
+
+    std::filesystem::remove(file);
+}
+
+// random lines of the characters that matter, scanned with each kernel, against the lexer a line at a time
+bool VerifyScanner()
+{
+    IniContext custom;
+    custom.sectionStart = '<';
+    custom.sectionEnd = '>';
+    custom.pairSeparator = ' ';
+    custom.commentsStart = "!";
+    custom.spaces = " _\t";
+
+    uint64_t random = 42;
+    const auto next = [&] {
+        // xorshift
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return random;
+    };
+
+    for (const auto &context : {IniContext(), custom})
+    {
+        const IniLexer lexer(context);
+        const IniHelper helper(context);
+
+        for (size_t i = 0; i < 2'000; i++)
+        {
+            // the odd ones with long lines, past a block of 64 bytes mostly, past the 4 KiB scanned at a time sometimes
+            constexpr std::string_view alphabet = "ab \t_=[]<>;#!\r\n\n";
+            const auto charsCount = i % 2 ? alphabet.size() : alphabet.size() - 2;
+
+            std::string data(next() % (i % 16 ? 300 : 10'000), '\0');
+            for (auto &c : data)
+            {
+                c = next() % 200 ? alphabet[next() % charsCount] : '\n';
+            }
+
+            using Tokens = std::vector<std::tuple<IniLexer::Token, std::string_view, std::string_view>>;
+            Tokens expected;
+            for (std::string_view rest(data); !rest.empty();)
+            {
+                const auto end = std::min(rest.find('\n'), rest.size());
+                const auto line = helper.Trim(rest.substr(0, end));
+                rest.remove_prefix(std::min(end + 1, rest.size()));
+
+                if (line.empty())
+                {
+                    continue;
+                }
+
+                switch (const auto token = lexer.FindToken(line))
+                {
+                case IniLexer::Token::SECTION:
+                    expected.emplace_back(token, lexer.ParseSectionView(line), std::string_view());
+                    break;
+
+                case IniLexer::Token::PAIR: {
+                    const auto [key, value] = lexer.ParsePairView(line);
+                    expected.emplace_back(token, key, value);
+                }
+                break;
+
+                default:
+                    expected.emplace_back(token, line, std::string_view());
+                    break;
+                }
+            }
+
+            const auto simdBest = IniLexer::GetSimd();
+            for (const auto simd : {IniLexer::Simd::SCALAR, IniLexer::Simd::AVX2, IniLexer::Simd::AVX512})
+            {
+                if (!IniLexer::SetSimd(simd))
+                {
+                    continue;
+                }
+
+                Tokens tokens;
+                lexer.Scan(data, [&](const IniLexer::Token aToken, const std::string_view aFirst,
+                                     const std::string_view aSecond) { tokens.emplace_back(aToken, aFirst, aSecond); });
+
+                // the same views, not only the same strings
+                const auto same = [](const auto &aLeft, const auto &aRight) {
+                    return std::get<0>(aLeft) == std::get<0>(aRight) &&
+                           std::get<1>(aLeft).data() == std::get<1>(aRight).data() &&
+                           std::get<1>(aLeft).size() == std::get<1>(aRight).size() &&
+                           std::get<2>(aLeft) == std::get<2>(aRight);
+                };
+                if (!std::ranges::equal(tokens, expected, same))
+                {
+                    std::cout << "the scanner disagrees with the lexer on a line of " << data.size()
+                              << " bytes with the kernel " << static_cast<int>(simd) << std::endl;
+                    IniLexer::SetSimd(simdBest);
+                    return false;
+                }
+            }
+            IniLexer::SetSimd(simdBest);
+        }
+    }
+
+    return true;
+}
+
 int main()
 {
+    if (!VerifyScanner())
+    {
+        return 1;
+    }
+
+    BenchmarkParsers();
+    BenchmarkLookups(20'000, 40);
+    BenchmarkLookups(20, 40);
+
     IniParser parser;
 
     std::ifstream ifs("input.ini");
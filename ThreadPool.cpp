@@ -1,227 +1,4451 @@
 #include <iostream>
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
 
-class Thread
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif // __linux__
+
+// per thread counters, histograms and trace events, compiled out when 0
+#ifndef THREAD_POOL_METRICS
+#define THREAD_POOL_METRICS 0
+#endif // !THREAD_POOL_METRICS
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, thieves steal from the top
+template <typename Type> class WorkStealingDeque
 {
+    static_assert(std::is_trivially_copyable_v<Type>, "The Type must be trivially copyable (use pointers)!");
+
   public:
-    enum class Priority : uint8_t
+    explicit WorkStealingDeque(const size_t aCapacity = 256) : mBuffer(new Buffer(std::bit_ceil(aCapacity)))
     {
-        LOW,    // last
-        MEDIUM, // middle
-        HIGH    // first
+        mBuffers.emplace_back(mBuffer.load(std::memory_order_relaxed));
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // owner only
+    void Push(const Type aItem)
+    {
+        const auto bottom = mBottom.load(std::memory_order_relaxed);
+        const auto top = mTop.load(std::memory_order_acquire);
+
+        auto buffer = mBuffer.load(std::memory_order_relaxed);
+        if (bottom - top >= static_cast<int64_t>(buffer->Capacity()))
+        {
+            buffer = Grow(buffer, top, bottom);
+        }
+
+        buffer->Put(bottom, aItem);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // owner only
+    std::optional<Type> Pop()
+    {
+        const auto bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        const auto buffer = mBuffer.load(std::memory_order_relaxed);
+
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = mTop.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // empty, restore
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return {};
+        }
+
+        std::optional<Type> item(buffer->Get(bottom));
+        if (top == bottom)
+        {
+            // the last item, race the thieves for it
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item.reset();
+            }
+
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    // any thread
+    std::optional<Type> Steal()
+    {
+        auto top = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto bottom = mBottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return {};
+        }
+
+        const auto item = mBuffer.load(std::memory_order_acquire)->Get(top);
+        if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            // lost the race against the owner or another thief
+            return {};
+        }
+
+        return item;
+    }
+
+    size_t Size() const noexcept
+    {
+        const auto bottom = mBottom.load(std::memory_order_relaxed);
+        const auto top = mTop.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+  private:
+    class Buffer
+    {
+      public:
+        explicit Buffer(const size_t aCapacity) : mMask(aCapacity - 1), mItems(new std::atomic<Type>[aCapacity])
+        {
+        }
+
+        size_t Capacity() const noexcept
+        {
+            return mMask + 1;
+        }
+
+        void Put(const int64_t aIndex, const Type aItem) noexcept
+        {
+            mItems[aIndex & mMask].store(aItem, std::memory_order_relaxed);
+        }
+
+        Type Get(const int64_t aIndex) const noexcept
+        {
+            return mItems[aIndex & mMask].load(std::memory_order_relaxed);
+        }
+
+      private:
+        size_t mMask{};
+        std::unique_ptr<std::atomic<Type>[]> mItems;
     };
 
-    // TODO: I think any deep copies the data, maybe void*
-    struct Task
+    alignas(64) std::atomic<int64_t> mTop{};
+    alignas(64) std::atomic<int64_t> mBottom{};
+    alignas(64) std::atomic<Buffer *> mBuffer{};
+
+    // thieves may still read from an old buffer, so they are freed only with the deque
+    std::vector<std::unique_ptr<Buffer>> mBuffers{};
+
+    Buffer *Grow(Buffer *aBuffer, const int64_t aTop, const int64_t aBottom)
     {
-        //              result, context
-        std::function<std::any(std::any)> work;
+        auto buffer = mBuffers.emplace_back(std::make_unique<Buffer>(aBuffer->Capacity() * 2)).get();
+        for (auto i = aTop; i < aBottom; i++)
+        {
+            buffer->Put(i, aBuffer->Get(i));
+        }
 
-        //                   result, context
-        std::function<void(std::any, std::any)> callback;
+        mBuffer.store(buffer, std::memory_order_release);
+        return buffer;
+    }
+};
 
-        std::any context;
+// the items behind the pointers of a WorkStealingDeque, in chunks reused rather than allocated one by one: the owner
+// takes slots from its own free list, the thieves give them back on a stack that the owner empties all at once (no ABA)
+template <typename Type> class SlotPool
+{
+  public:
+    struct Slot
+    {
+        Type item{};
+        Slot *next{};
     };
 
-    Thread(const bool aStart = false)
+    SlotPool() = default;
+
+    SlotPool(const SlotPool &) = delete;
+    SlotPool &operator=(const SlotPool &) = delete;
+
+    // owner only
+    Slot *Take()
     {
-        if (aStart)
+        if (!mFree)
         {
-            Start();
+            mFree = mReturned.exchange(nullptr, std::memory_order_acquire);
+        }
+
+        if (!mFree)
+        {
+            Grow();
         }
+
+        return std::exchange(mFree, mFree->next);
     }
 
-    bool Add(Task &&aTask, const Priority aPriority = Priority::LOW)
+    // owner only
+    void Give(Slot *aSlot) noexcept
     {
-        std::scoped_lock lock(mMutexTasks);
+        aSlot->next = std::exchange(mFree, aSlot);
+    }
 
-        switch (aPriority)
+    // any thread
+    void GiveBack(Slot *aSlot) noexcept
+    {
+        auto head = mReturned.load(std::memory_order_relaxed);
+        do
         {
-        case Priority::LOW:
-            mTasks.emplace_back(std::move(aTask));
-            return true;
+            aSlot->next = head;
+        } while (!mReturned.compare_exchange_weak(head, aSlot, std::memory_order_release, std::memory_order_relaxed));
+    }
 
-        case Priority::MEDIUM: {
-            const auto index = static_cast<ptrdiff_t>(mTasks.size() / 2.);
-            const auto it = std::next(mTasks.begin(), index);
+  private:
+    static constexpr size_t CHUNK_SIZE = 256;
 
-            mTasks.emplace(it, std::move(aTask));
-            return true;
+    std::vector<std::unique_ptr<Slot[]>> mChunks{};
+    Slot *mFree{};
+    alignas(64) std::atomic<Slot *> mReturned{};
+
+    void Grow()
+    {
+        const auto &chunk = mChunks.emplace_back(std::make_unique<Slot[]>(CHUNK_SIZE));
+        for (size_t i = CHUNK_SIZE; i > 0; i--)
+        {
+            Give(&chunk[i - 1]);
         }
+    }
+};
 
-        case Priority::HIGH:
-            mTasks.emplace_front(std::move(aTask));
-            return true;
+// growable ring buffer, O(1) push and pop at both ends
+template <typename Type> class RingQueue
+{
+  public:
+    bool Empty() const noexcept
+    {
+        return !mSize;
+    }
 
-        default:
-            return false;
-        }
+    size_t Size() const noexcept
+    {
+        return mSize;
     }
 
-    size_t TaskCount()
+    void PushBack(Type &&aItem)
     {
-        std::scoped_lock lock(mMutexTasks);
-        return mTasks.size();
+        Reserve();
+        mItems[(mHead + mSize++) & (mItems.size() - 1)] = std::move(aItem);
     }
 
-    bool HasWork()
+    void PushFront(Type &&aItem)
     {
-        std::scoped_lock lock(mMutexTasks);
-        return TaskCount();
+        Reserve();
+        mHead = (mHead - 1) & (mItems.size() - 1);
+        mItems[mHead] = std::move(aItem);
+        mSize++;
     }
 
-    void Start()
+    Type PopFront()
     {
-        mRunning = true;
+        auto item = std::move(mItems[mHead]);
+        mHead = (mHead + 1) & (mItems.size() - 1);
+        mSize--;
+        return item;
+    }
 
-        mThread = std::thread(std::bind(&Thread::Run, this));
+    Type PopBack()
+    {
+        return std::move(mItems[(mHead + --mSize) & (mItems.size() - 1)]);
     }
 
-    void Stop()
+  private:
+    std::vector<Type> mItems{};
+    size_t mHead{};
+    size_t mSize{};
+
+    void Reserve()
     {
-        mRunning = false;
+        if (mSize < mItems.size())
+        {
+            return;
+        }
 
-        if (mThread.joinable())
+        std::vector<Type> items(std::max<size_t>(mItems.size() * 2, 16));
+        for (size_t i = 0; i < mSize; i++)
         {
-            mThread.join();
+            items[i] = std::move(mItems[(mHead + i) & (mItems.size() - 1)]);
         }
+
+        mItems = std::move(items);
+        mHead = 0;
     }
+};
 
-    ~Thread()
+// log2 buckets of nanoseconds, bucket i holds the durations in [2^(i-1), 2^i) ns
+class Histogram
+{
+  public:
+    static constexpr size_t BUCKETS_COUNT = 64;
+
+    void Record(const std::chrono::nanoseconds aDuration) noexcept
     {
-        Stop();
+        const auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(aDuration.count(), 0));
+        mBuckets[std::min<size_t>(std::bit_width(nanoseconds), BUCKETS_COUNT - 1)].fetch_add(
+            1, std::memory_order_relaxed);
     }
 
-  private:
-    std::recursive_mutex mMutexTasks{};
-    std::list<Task> mTasks{};
-
-    std::atomic_bool mRunning{};
-    std::thread mThread{};
+    uint64_t Bucket(const size_t aIndex) const noexcept
+    {
+        return mBuckets[aIndex].load(std::memory_order_relaxed);
+    }
 
-    void Run()
+    uint64_t Count() const noexcept
     {
-        while (mRunning)
+        uint64_t count{};
+        for (const auto &bucket : mBuckets)
         {
-            // wait for work
-            while (mRunning && !HasWork())
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(2));
-            }
+            count += bucket.load(std::memory_order_relaxed);
+        }
 
-            // lock and check again
-            std::unique_lock lock(mMutexTasks);
-            if (!mRunning || !HasWork())
+        return count;
+    }
+
+    // an upper bound of the aPercent-th percentile
+    std::chrono::nanoseconds Percentile(const double aPercent) const noexcept
+    {
+        const auto count = Count();
+
+        uint64_t seen{};
+        for (size_t i = 0; i < mBuckets.size(); i++)
+        {
+            seen += mBuckets[i].load(std::memory_order_relaxed);
+            if (count && seen * 100. >= count * aPercent)
             {
-                // no more work, go wait again
-                lock.unlock();
-                continue;
+                return std::chrono::nanoseconds(uint64_t{1} << i);
             }
+        }
 
-            // get the task and unlock
-            Task task(std::move(mTasks.front()));
-            mTasks.pop_front();
-
-            lock.unlock();
+        return {};
+    }
 
-            // work
-            task.callback(task.work(task.context), task.context);
+    void Merge(const Histogram &aHistogram) noexcept
+    {
+        for (size_t i = 0; i < mBuckets.size(); i++)
+        {
+            mBuckets[i].fetch_add(aHistogram.Bucket(i), std::memory_order_relaxed);
         }
     }
+
+  private:
+    std::array<std::atomic_uint64_t, BUCKETS_COUNT> mBuckets{};
 };
 
-class ThreadPool
+struct TraceEvent
+{
+    const char *name;
+    size_t threadIndex;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds duration;
+};
+
+// collects trace events and writes them as Chrome trace-event JSON, for chrome://tracing or ui.perfetto.dev
+class ChromeTrace
 {
   public:
-    struct Options
+    ChromeTrace() : mStart(std::chrono::steady_clock::now())
     {
-        Thread::Priority priority = Thread::Priority::LOW;
-        uint8_t threadIndex = 0; // 0 == most free thread
-    };
+    }
 
-    ThreadPool(const bool aStart = false, const uint8_t aThreadsCount = 2) : mThreads(aThreadsCount)
+    // to be set as ThreadPool::Config::trace
+    std::function<void(const TraceEvent &)> Hook()
     {
-        if (aStart)
-        {
-            Start();
-        }
+        return [this](const TraceEvent &aEvent) {
+            std::scoped_lock lock(mMutex);
+            mEvents.push_back(aEvent);
+        };
     }
 
-    bool Add(Thread::Task &&aTask, const Options &aOptions = {})
+    void Write(std::ostream &aStream) const
     {
-        if (aOptions.threadIndex > mThreads.size())
+        std::scoped_lock lock(mMutex);
+
+        aStream << "{\"traceEvents\":[";
+        for (size_t i = 0; i < mEvents.size(); i++)
         {
-            return false;
+            const auto &event = mEvents[i];
+            const std::chrono::duration<double, std::micro> start = event.start - mStart;
+            const std::chrono::duration<double, std::micro> duration = event.duration;
+
+            aStream << (i ? "," : "") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                    << event.threadIndex << ",\"ts\":" << start.count() << ",\"dur\":" << duration.count() << "}";
         }
+        aStream << "\n]}" << std::endl;
+    }
 
-        if (aOptions.threadIndex)
+  private:
+    std::chrono::steady_clock::time_point mStart;
+
+    mutable std::mutex mMutex{};
+    std::vector<TraceEvent> mEvents{};
+};
+
+// move only void() callable, small ones are stored inline instead of on the heap
+class Job
+{
+  public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    constexpr Job() noexcept = default;
+
+    template <typename Function>
+        requires(!std::same_as<std::decay_t<Function>, Job> && std::invocable<std::decay_t<Function> &>)
+    Job(Function &&aFunction)
+    {
+        using Callable = std::decay_t<Function>;
+
+        if constexpr (IsInline<Callable>())
         {
-            return mThreads[aOptions.threadIndex - 1].Add(std::move(aTask), aOptions.priority);
+            new (mStorage) Callable(std::forward<Function>(aFunction));
         }
         else
         {
-            return ChooseThread().Add(std::move(aTask), aOptions.priority);
+            *reinterpret_cast<Callable **>(mStorage) = new Callable(std::forward<Function>(aFunction));
         }
+
+        mOperations = &OPERATIONS<Callable>;
     }
 
-    void Start()
+    Job(Job &&aJob) noexcept
     {
-        for (auto &thread : mThreads)
+        *this = std::move(aJob);
+    }
+
+    Job &operator=(Job &&aJob) noexcept
+    {
+        if (this != &aJob)
         {
-            thread.Start();
+            Reset();
+
+            if (aJob.mOperations)
+            {
+                aJob.mOperations->relocate(aJob.mStorage, mStorage);
+                mOperations = std::exchange(aJob.mOperations, nullptr);
+#if THREAD_POOL_METRICS
+                mQueued = aJob.mQueued;
+#endif // THREAD_POOL_METRICS
+            }
         }
+
+        return *this;
     }
 
-    void Stop()
+    Job(const Job &) = delete;
+    Job &operator=(const Job &) = delete;
+
+    ~Job()
     {
-        for (auto &thread : mThreads)
+        Reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return mOperations;
+    }
+
+    void operator()()
+    {
+        mOperations->invoke(mStorage);
+    }
+
+    void Reset() noexcept
+    {
+        if (mOperations)
         {
-            thread.Stop();
+            std::exchange(mOperations, nullptr)->destroy(mStorage);
         }
     }
 
-    ~ThreadPool()
+#if THREAD_POOL_METRICS
+    void MarkQueued() noexcept
     {
-        Stop();
+        mQueued = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::steady_clock::time_point QueuedAt() const noexcept
+    {
+        return mQueued;
     }
+#else
+    constexpr void MarkQueued() const noexcept
+    {
+    }
+#endif // THREAD_POOL_METRICS
 
   private:
-    std::vector<Thread> mThreads{};
+    struct Operations
+    {
+        void (*invoke)(void *aStorage);
+        void (*relocate)(void *aFrom, void *aTo) noexcept;
+        void (*destroy)(void *aStorage) noexcept;
+    };
 
-    Thread &ChooseThread()
+    template <typename Callable> static constexpr bool IsInline() noexcept
     {
-        size_t index{};
-        for (size_t i = 1; i < mThreads.size(); i++)
-        {
-            if (mThreads[index].TaskCount() > mThreads[i].TaskCount())
+        return sizeof(Callable) <= INLINE_SIZE && alignof(Callable) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Callable>;
+    }
+
+    template <typename Callable> static constexpr Operations OPERATIONS = {
+        [](void *aStorage) {
+            if constexpr (IsInline<Callable>())
             {
-                index = i;
+                (*static_cast<Callable *>(aStorage))();
             }
-        }
+            else
+            {
+                (**static_cast<Callable **>(aStorage))();
+            }
+        },
+        [](void *aFrom, void *aTo) noexcept {
+            if constexpr (IsInline<Callable>())
+            {
+                new (aTo) Callable(std::move(*static_cast<Callable *>(aFrom)));
+                static_cast<Callable *>(aFrom)->~Callable();
+            }
+            else
+            {
+                std::memcpy(aTo, aFrom, sizeof(Callable *));
+            }
+        },
+        [](void *aStorage) noexcept {
+            if constexpr (IsInline<Callable>())
+            {
+                static_cast<Callable *>(aStorage)->~Callable();
+            }
+            else
+            {
+                delete *static_cast<Callable **>(aStorage);
+            }
+        }};
 
-        return mThreads[index];
-    }
+    alignas(std::max_align_t) std::byte mStorage[INLINE_SIZE]{};
+    const Operations *mOperations{};
+
+#if THREAD_POOL_METRICS
+    std::chrono::steady_clock::time_point mQueued{};
+#endif // THREAD_POOL_METRICS
 };
 
-std::any Work(std::any aContext)
+// the CPUs of each NUMA node and the pinning of the calling thread to some of them
+class Topology
 {
-    std::cout << "start task no. " << std::any_cast<size_t>(aContext) << " on thread " << std::this_thread::get_id()
-              << std::endl;
-    return true;
-}
+  public:
+    // read from /sys on linux, a single node with all the CPUs otherwise
+    static std::vector<std::vector<size_t>> Nodes()
+    {
+        std::vector<std::vector<size_t>> nodes;
 
-void Callback(std::any aResult, std::any aContext)
-{
-    std::cout << "end task no. " << std::any_cast<size_t>(aContext) << " on thread " << std::this_thread::get_id()
-              << " with " << std::any_cast<bool>(aResult) << std::endl;
-}
+#ifdef __linux__
+        std::error_code error;
+        for (size_t node = 0;; node++)
+        {
+            const std::filesystem::path directory("/sys/devices/system/node/node" + std::to_string(node));
+            if (!std::filesystem::exists(directory, error))
+            {
+                // the node ids may have gaps, "possible" knows the last one
+                if (node > LastNode())
+                {
+                    break;
+                }
+
+                continue;
+            }
+
+            std::ifstream ifs(directory / "cpulist");
+            std::string cpus;
+            if (std::getline(ifs, cpus) && !ParseList(cpus).empty())
+            {
+                nodes.emplace_back(ParseList(cpus));
+            }
+        }
+#endif // __linux__
+
+        if (nodes.empty())
+        {
+            auto &cpus = nodes.emplace_back(std::max(1u, std::thread::hardware_concurrency()));
+            std::iota(cpus.begin(), cpus.end(), size_t{});
+        }
+
+        return nodes;
+    }
+
+    // pins the calling thread to aCpus, false if not supported or not allowed
+    static bool Pin(const std::vector<size_t> &aCpus) noexcept
+    {
+#ifdef __linux__
+        // sized for the highest CPU from /sys, a cpu_set_t holds only CPU_SETSIZE of them, the _S macros skip any past
+        // the set allocated
+        const auto count = static_cast<int>(std::min<size_t>(
+            aCpus.empty() ? 1 : *std::ranges::max_element(aCpus) + 1, std::numeric_limits<int>::max()));
+        auto *set = CPU_ALLOC(count);
+        if (!set)
+        {
+            return false;
+        }
+
+        const auto size = CPU_ALLOC_SIZE(count);
+        CPU_ZERO_S(size, set);
+        for (const auto cpu : aCpus)
+        {
+            CPU_SET_S(cpu, size, set);
+        }
+
+        const auto pinned = !sched_setaffinity(0, size, set);
+        CPU_FREE(set);
+        return pinned;
+#else
+        (void)aCpus;
+        return false;
+#endif // __linux__
+    }
+
+  private:
+    // "0-3,8,10-11" to {0, 1, 2, 3, 8, 10, 11}
+    static std::vector<size_t> ParseList(const std::string &aList)
+    {
+        std::vector<size_t> values;
+
+        size_t position{};
+        while (position < aList.size() && std::isdigit(static_cast<unsigned char>(aList[position])))
+        {
+            size_t length{};
+            const auto first = std::stoull(aList.substr(position), &length);
+            position += length;
+
+            auto last = first;
+            if (position < aList.size() && aList[position] == '-')
+            {
+                last = std::stoull(aList.substr(++position), &length);
+                position += length;
+            }
+
+            for (auto value = first; value <= last; value++)
+            {
+                values.push_back(value);
+            }
+
+            // skip the comma
+            position++;
+        }
+
+        return values;
+    }
+
+    static size_t LastNode()
+    {
+#ifdef __linux__
+        std::ifstream ifs("/sys/devices/system/node/possible");
+        std::string nodes;
+        if (std::getline(ifs, nodes) && !ParseList(nodes).empty())
+        {
+            return ParseList(nodes).back();
+        }
+#endif // __linux__
+
+        return 0;
+    }
+};
+
+// hierarchical timer wheel, O(1) add and cancel, the jobs run on its own thread so they must be short
+class TimerWheel
+{
+  public:
+    // a handle to cancel a timer, stale once the timer fired or was cancelled
+    class Timer
+    {
+      public:
+        constexpr Timer() noexcept = default;
+
+        // false if the timer could not be added
+        bool Valid() const noexcept
+        {
+            return mWheel;
+        }
+
+        // false if it already fired, or was cancelled, a periodic one being run finishes that run
+        bool Cancel() const
+        {
+            return mWheel && mWheel->Cancel(*this);
+        }
+
+      private:
+        friend class TimerWheel;
+
+        TimerWheel *mWheel{};
+        uint32_t mIndex{};
+        uint32_t mGeneration{};
+
+        Timer(TimerWheel *aWheel, const uint32_t aIndex, const uint32_t aGeneration) noexcept
+            : mWheel(aWheel), mIndex(aIndex), mGeneration(aGeneration)
+        {
+        }
+    };
+
+    explicit TimerWheel(const std::chrono::nanoseconds aTick = std::chrono::milliseconds(1))
+        : mTick(std::max(aTick, std::chrono::nanoseconds(1)))
+    {
+        for (auto &level : mSlots)
+        {
+            level.fill(NONE);
+        }
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // aJob runs once after aDelay, or every aPeriod after that if aPeriod is not zero, never early
+    Timer Add(const std::chrono::nanoseconds aDelay, const std::chrono::nanoseconds aPeriod, Job &&aJob)
+    {
+        std::scoped_lock lock(mMutex);
+
+        // nothing to advance, skip the ticks that went by idle
+        const auto now = Now();
+        if (!mCount)
+        {
+            mCurrent = std::max(mCurrent, now);
+        }
+
+        uint32_t index;
+        if (mFree != NONE)
+        {
+            index = std::exchange(mFree, mNodes[mFree].next);
+        }
+        else
+        {
+            index = static_cast<uint32_t>(mNodes.size());
+            mNodes.emplace_back();
+        }
+
+        auto &node = mNodes[index];
+        node.job = std::move(aJob);
+        node.expiry = std::max(ToTicks(std::chrono::steady_clock::now() - mStart + aDelay), mCurrent + 1);
+        node.period = aPeriod.count() > 0 ? std::max<uint64_t>(ToTicks(aPeriod), 1) : 0;
+        node.firing = false;
+        Insert(index);
+
+        // sooner than the timer thread planned to wake up
+        if (node.expiry < mWakeTick)
+        {
+            mWake.notify_one();
+        }
+
+        return Timer(this, index, node.generation);
+    }
+
+    bool Cancel(const Timer &aTimer)
+    {
+        std::scoped_lock lock(mMutex);
+        if (aTimer.mWheel != this || aTimer.mIndex >= mNodes.size())
+        {
+            return false;
+        }
+
+        auto &node = mNodes[aTimer.mIndex];
+        if (node.generation != aTimer.mGeneration)
+        {
+            return false;
+        }
+
+        // the timer thread frees it once the run is over
+        if (node.firing)
+        {
+            node.generation++;
+            return true;
+        }
+
+        Unlink(aTimer.mIndex);
+        Free(aTimer.mIndex);
+        return true;
+    }
+
+    // the timers waiting in the wheel
+    size_t Count() const
+    {
+        std::scoped_lock lock(mMutex);
+        return mCount;
+    }
+
+    // the tick the running timer fired on, counted from the construction of the wheel, only from its job
+    uint64_t FiringTick() const noexcept
+    {
+        return mFiringTick;
+    }
+
+    void Start()
+    {
+        std::scoped_lock lock(mMutex);
+        if (mRunning)
+        {
+            return;
+        }
+
+        mRunning = true;
+        mThread = std::thread(std::bind(&TimerWheel::Run, this));
+    }
+
+    // the timers are kept, the ones due meanwhile fire after the next Start
+    void Stop()
+    {
+        {
+            std::scoped_lock lock(mMutex);
+            mRunning = false;
+        }
+        mWake.notify_one();
+
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+    }
+
+    // every timer waiting, their jobs destroyed outside the lock
+    void Clear()
+    {
+        std::vector<Job> jobs;
+        {
+            std::scoped_lock lock(mMutex);
+            for (auto &level : mSlots)
+            {
+                for (auto &head : level)
+                {
+                    for (auto index = std::exchange(head, NONE); index != NONE;)
+                    {
+                        auto &node = mNodes[index];
+                        const auto next = node.next;
+                        jobs.push_back(std::move(node.job));
+                        node.slot = NONE;
+                        mCount--;
+
+                        Free(index);
+                        index = next;
+                    }
+                }
+            }
+        }
+    }
+
+    ~TimerWheel()
+    {
+        Stop();
+    }
+
+  private:
+    struct Node
+    {
+        Job job{};
+        uint64_t expiry{}; // in ticks since mStart
+        uint64_t period{}; // in ticks, 0 == once
+
+        // in the list of a slot, next also links the free nodes
+        uint32_t previous = NONE;
+        uint32_t next = NONE;
+        uint32_t slot = NONE; // level * SLOTS_COUNT + slot
+
+        uint32_t generation{};
+        bool firing{}; // a periodic one, out of the wheel while its job runs
+    };
+
+    struct Fired
+    {
+        uint32_t index;
+        uint32_t generation; // changed if cancelled while running
+        bool periodic;
+        uint64_t tick;
+        Job job;
+    };
+
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    // each level is SLOTS_COUNT times coarser than the one below, 4 levels of 64 cover 2^24 ticks
+    static constexpr size_t LEVELS_COUNT = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS_COUNT = size_t{1} << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS_COUNT - 1;
+    static constexpr uint64_t SPAN = uint64_t{1} << (SLOT_BITS * LEVELS_COUNT);
+
+    const std::chrono::steady_clock::time_point mStart = std::chrono::steady_clock::now();
+    const std::chrono::nanoseconds mTick;
+
+    mutable std::mutex mMutex{};
+    std::condition_variable mWake{};
+    std::thread mThread{};
+    bool mRunning{};
+
+    std::vector<Node> mNodes{};
+    uint32_t mFree = NONE;
+    size_t mCount{};
+
+    // the heads of the slot lists
+    std::array<std::array<uint32_t, SLOTS_COUNT>, LEVELS_COUNT> mSlots{};
+
+    // every tick up to this one was processed
+    uint64_t mCurrent{};
+    uint64_t mWakeTick = std::numeric_limits<uint64_t>::max();
+    uint64_t mFiringTick{}; // only touched by the timer thread
+
+    // rounded up, a timer never fires early
+    uint64_t ToTicks(const std::chrono::nanoseconds aDuration) const noexcept
+    {
+        return static_cast<uint64_t>(
+            (std::max(aDuration, std::chrono::nanoseconds()) + mTick - std::chrono::nanoseconds(1)) / mTick);
+    }
+
+    uint64_t Now() const noexcept
+    {
+        return static_cast<uint64_t>((std::chrono::steady_clock::now() - mStart) / mTick);
+    }
+
+    // expects the lock and an expiry past mCurrent, or at it while cascading so that it fires in this very tick
+    void Insert(const uint32_t aIndex)
+    {
+        auto &node = mNodes[aIndex];
+
+        // beyond the span it goes to the top level, and is placed again once cascaded
+        const auto place = std::min(node.expiry, mCurrent + SPAN - 1);
+        const auto delta = place - mCurrent;
+
+        size_t level{};
+        while (delta >> (SLOT_BITS * (level + 1)))
+        {
+            level++;
+        }
+
+        const auto slot = (place >> (SLOT_BITS * level)) & SLOT_MASK;
+        auto &head = mSlots[level][slot];
+
+        node.slot = static_cast<uint32_t>(level * SLOTS_COUNT + slot);
+        node.previous = NONE;
+        node.next = head;
+        if (head != NONE)
+        {
+            mNodes[head].previous = aIndex;
+        }
+        head = aIndex;
+
+        mCount++;
+    }
+
+    // expects the lock and the node in the wheel
+    void Unlink(const uint32_t aIndex)
+    {
+        auto &node = mNodes[aIndex];
+        if (node.previous != NONE)
+        {
+            mNodes[node.previous].next = node.next;
+        }
+        else
+        {
+            mSlots[node.slot / SLOTS_COUNT][node.slot % SLOTS_COUNT] = node.next;
+        }
+
+        if (node.next != NONE)
+        {
+            mNodes[node.next].previous = node.previous;
+        }
+
+        node.slot = NONE;
+        mCount--;
+    }
+
+    void Free(const uint32_t aIndex)
+    {
+        auto &node = mNodes[aIndex];
+        node.job.Reset();
+        node.generation++;
+        node.next = std::exchange(mFree, aIndex);
+    }
+
+    // moves the slot of the tick down a level, or to aFired once due
+    void Advance(std::vector<Fired> &aFired)
+    {
+        const auto tick = ++mCurrent;
+
+        // the coarser levels first, their timers may land on a finer slot of this very tick
+        for (size_t level = LEVELS_COUNT - 1; level > 0; level--)
+        {
+            if (tick & ((uint64_t{1} << (SLOT_BITS * level)) - 1))
+            {
+                continue;
+            }
+
+            auto index = std::exchange(mSlots[level][(tick >> (SLOT_BITS * level)) & SLOT_MASK], NONE);
+            while (index != NONE)
+            {
+                const auto next = mNodes[index].next;
+                mCount--;
+                Insert(index);
+                index = next;
+            }
+        }
+
+        auto index = std::exchange(mSlots[0][tick & SLOT_MASK], NONE);
+        while (index != NONE)
+        {
+            auto &node = mNodes[index];
+            const auto next = node.next;
+            mCount--;
+            node.slot = NONE;
+
+            aFired.push_back({index, node.generation, node.period != 0, tick, std::move(node.job)});
+            if (node.period)
+            {
+                node.firing = true;
+            }
+            else
+            {
+                Free(index);
+            }
+
+            index = next;
+        }
+    }
+
+    // the next tick with timers at the lowest level, or the next cascade
+    uint64_t NextTick() const noexcept
+    {
+        auto tick = mCurrent + 1;
+        while (mSlots[0][tick & SLOT_MASK] == NONE && (tick & SLOT_MASK))
+        {
+            tick++;
+        }
+
+        return tick;
+    }
+
+    void Run()
+    {
+        std::vector<Fired> fired;
+
+        std::unique_lock lock(mMutex);
+        while (mRunning)
+        {
+            if (!mCount)
+            {
+                mWakeTick = std::numeric_limits<uint64_t>::max();
+                mWake.wait(lock);
+                continue;
+            }
+
+            const auto now = Now();
+            if (mCurrent >= now)
+            {
+                mWakeTick = NextTick();
+                mWake.wait_until(lock, mStart + mWakeTick * mTick);
+                continue;
+            }
+
+            while (mCurrent < now)
+            {
+                Advance(fired);
+            }
+
+            lock.unlock();
+            for (auto &timer : fired)
+            {
+                mFiringTick = timer.tick;
+                timer.job();
+            }
+            lock.lock();
+
+            // the periodic ones go back in, unless cancelled meanwhile
+            for (auto &timer : fired)
+            {
+                if (!timer.periodic)
+                {
+                    continue;
+                }
+
+                auto &node = mNodes[timer.index];
+                node.firing = false;
+                if (node.generation != timer.generation)
+                {
+                    Free(timer.index);
+                    continue;
+                }
+
+                node.job = std::move(timer.job);
+                node.expiry = std::max(node.expiry + node.period, mCurrent + 1);
+                Insert(timer.index);
+            }
+            fired.clear();
+        }
+    }
+};
+
+class Thread
+{
+  public:
+    enum class Priority : uint8_t
+    {
+        LOW,    // last
+        MEDIUM, // after the high ones, in order
+        HIGH    // first, the newest one first
+    };
+
+    enum class Wait : uint8_t
+    {
+        PARK,          // sleep right away until there is work
+        SPIN_THEN_PARK // spin for a short, adaptive while before sleeping
+    };
+
+    // only filled with THREAD_POOL_METRICS, written by the worker, readable from anywhere
+    struct Metrics
+    {
+        std::atomic_uint64_t tasksExecuted{};
+        std::atomic_uint64_t steals{};
+        std::atomic_uint64_t idleNanoseconds{};
+        std::atomic_uint64_t busyNanoseconds{};
+        std::atomic_uint64_t queueDepthMax{};
+
+        Histogram queueWait{}; // from queued until started
+        Histogram runTime{};
+    };
+
+    // std::function and std::any may allocate and copy, prefer ThreadPool::Submit on hot paths
+    struct Task
+    {
+        //              result, context
+        std::function<std::any(std::any)> work;
+
+        //                   result, context
+        std::function<void(std::any, std::any)> callback;
+
+        std::any context;
+    };
+
+    Thread(const bool aStart = false)
+    {
+        if (aStart)
+        {
+            Start();
+        }
+    }
+
+    // the thread of the caller if it is a worker, nullptr otherwise
+    static Thread *Current() noexcept
+    {
+        return sCurrent;
+    }
+
+    // enables work stealing from the other threads of the same group
+    void SetSiblings(std::vector<Thread> *aSiblings) noexcept
+    {
+        mSiblings = aSiblings;
+    }
+
+    bool IsSibling(const std::vector<Thread> *aSiblings) const noexcept
+    {
+        return mSiblings && mSiblings == aSiblings;
+    }
+
+    void SetWait(const Wait aWait) noexcept
+    {
+        mWait = aWait;
+    }
+
+    // the NUMA node the thread belongs to and the CPUs it gets pinned to once started, none means any
+    void SetPlacement(const size_t aNode, std::vector<size_t> aCpus)
+    {
+        mNode = aNode;
+        mCpus = std::move(aCpus);
+    }
+
+    size_t GetNode() const noexcept
+    {
+        return mNode;
+    }
+
+    void SetTrace(const size_t aIndex, std::function<void(const TraceEvent &)> aTrace)
+    {
+        mIndex = aIndex;
+        mTrace = std::move(aTrace);
+    }
+
+    const Metrics &GetMetrics() const noexcept
+    {
+        return mMetrics;
+    }
+
+    // counts the queued and running tasks of the whole group, shared by all of its threads
+    void SetPending(std::atomic_size_t *aPending) noexcept
+    {
+        mPending = aPending;
+    }
+
+    // zero while the thread has work or is not parked
+    std::chrono::nanoseconds IdleFor() const noexcept
+    {
+        const auto since = mIdleSince.load(std::memory_order_relaxed);
+        if (!since)
+        {
+            return {};
+        }
+
+        return std::chrono::steady_clock::now().time_since_epoch() - std::chrono::nanoseconds(since);
+    }
+
+    static Job ToJob(Task &&aTask)
+    {
+        return [task = std::move(aTask)]() mutable {
+            auto result = task.work(task.context);
+            task.callback(std::move(result), std::move(task.context));
+        };
+    }
+
+    // only from the thread itself, bypasses the priority queue and the lock
+    void Push(Job &&aJob)
+    {
+        aJob.MarkQueued();
+        AddPending(1);
+        mDeque.Push(Store(std::move(aJob)));
+        UpdateQueueDepth();
+        NotifySibling();
+    }
+
+    bool Add(Task &&aTask, const Priority aPriority = Priority::LOW)
+    {
+        return Add(ToJob(std::move(aTask)), aPriority);
+    }
+
+    bool Add(Job &&aJob, const Priority aPriority = Priority::LOW)
+    {
+        if (!Enqueue(std::move(aJob), aPriority))
+        {
+            return false;
+        }
+
+        // a busy thread gets help from an idle sibling
+        if (!Notify())
+        {
+            NotifySibling();
+        }
+
+        return true;
+    }
+
+    // all of aJobs under a single lock and a single wake up, returns how many were added
+    size_t AddBatch(const std::span<Job> aJobs, const Priority aPriority = Priority::LOW)
+    {
+        size_t count{};
+        {
+            std::scoped_lock lock(mMutexTasks);
+            for (auto &job : aJobs)
+            {
+                count += Insert(std::move(job), aPriority);
+            }
+        }
+
+        if (count && !Notify())
+        {
+            NotifySibling();
+        }
+
+        return count;
+    }
+
+    // only from the thread itself, without any lock
+    void PushBatch(const std::span<Job> aJobs)
+    {
+        AddPending(aJobs.size());
+        for (auto &job : aJobs)
+        {
+            job.MarkQueued();
+            mDeque.Push(Store(std::move(job)));
+        }
+        UpdateQueueDepth();
+
+        NotifySibling();
+    }
+
+    // runs one own task, or a stolen one, from the thread itself
+    bool RunOne()
+    {
+        Job job;
+        if (!TakeOwn(job) && !(mSiblings && Steal(job)))
+        {
+            return false;
+        }
+
+        Execute(job);
+        return true;
+    }
+
+    // runs one task of this thread from any other thread
+    bool RunStolen()
+    {
+        Job job;
+        if (!TakeStolen(job))
+        {
+            return false;
+        }
+
+        Execute(job);
+        return true;
+    }
+
+    // takes a queued task without running it, from any other thread, for a thread that was retired
+    bool Evict(Job &aJob)
+    {
+        return TakeStolen(aJob);
+    }
+
+    // without locking, so it may be stale by the time it returns
+    size_t TaskCount() const noexcept
+    {
+        return mTasksCount.load(std::memory_order_relaxed) + mDeque.Size();
+    }
+
+    bool HasWork()
+    {
+        std::scoped_lock lock(mMutexTasks);
+        return TaskCount();
+    }
+
+    bool IsRunning() const noexcept
+    {
+        return mRunning;
+    }
+
+    void Start()
+    {
+        // a retiring thread still draining its tasks is kept on, waiting for it could take as long as its task
+        auto retiring = Retirement::RETIRING;
+        if (mRunning && mRetirement.compare_exchange_strong(retiring, Retirement::NONE))
+        {
+            Notify();
+            return;
+        }
+
+        // a retired thread is restarted on a fresh std::thread, the old one left its loop already or was stopped
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+
+        mRetirement = Retirement::NONE;
+        mRunning = true;
+
+        mThread = std::thread(std::bind(&Thread::Run, this));
+    }
+
+    // the thread exits once it has no more own tasks, unlike Stop it does not wait for it
+    void Retire()
+    {
+        mRetirement = Retirement::RETIRING;
+        Notify();
+    }
+
+    void Stop()
+    {
+        mRunning = false;
+        Notify();
+
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+    }
+
+    ~Thread()
+    {
+        Stop();
+
+        while (const auto task = mDeque.Pop())
+        {
+            (*task)->item.Reset();
+        }
+    }
+
+  private:
+    static inline thread_local Thread *sCurrent{};
+
+    std::recursive_mutex mMutexTasks{};
+    // a bucket per priority, indexed by Priority
+    std::array<RingQueue<Job>, 3> mTasks{};
+    std::array<uint32_t, 3> mTasksSkipped{};
+    std::atomic_size_t mTasksCount{}; // changed under the lock, read without it
+
+    // the deque holds slots of mSlots rather than a Job allocated per task
+    SlotPool<Job> mSlots{};
+    WorkStealingDeque<SlotPool<Job>::Slot *> mDeque{};
+    std::vector<Thread> *mSiblings{};
+
+    std::atomic_bool mRunning{};
+    // RETIRING until the thread leaves, unless it is started again before
+    enum class Retirement : uint8_t
+    {
+        NONE,
+        RETIRING,
+        LEFT
+    };
+    std::atomic<Retirement> mRetirement{};
+    std::thread mThread{};
+    std::atomic_size_t *mPending{};
+
+    Wait mWait = Wait::PARK;
+    uint32_t mSpinLimit = SPIN_LIMIT_MIN;
+
+    size_t mNode{};
+    std::vector<size_t> mCpus{};
+
+    size_t mIndex{};
+    std::function<void(const TraceEvent &)> mTrace{};
+    Metrics mMetrics{};
+
+    // bumped on every new task, the parked thread waits for it to change
+    std::atomic_uint32_t mSignal{};
+    std::atomic_bool mParked{};
+    std::atomic_int64_t mIdleSince{}; // steady clock nanoseconds when parked, zero otherwise
+
+    static constexpr uint32_t SPIN_LIMIT_MIN = 1 << 4;
+    static constexpr uint32_t SPIN_LIMIT_MAX = 1 << 14;
+
+    // how many times a bucket can be passed over before it is served anyway, keeps LOW from starving
+    static constexpr uint32_t AGING_LIMIT = 64;
+
+    bool Enqueue(Job &&aJob, const Priority aPriority)
+    {
+        std::scoped_lock lock(mMutexTasks);
+        return Insert(std::move(aJob), aPriority);
+    }
+
+    // expects the lock
+    bool Insert(Job &&aJob, const Priority aPriority)
+    {
+        aJob.MarkQueued();
+
+        switch (aPriority)
+        {
+        case Priority::LOW:
+        case Priority::MEDIUM:
+            mTasks[static_cast<size_t>(aPriority)].PushBack(std::move(aJob));
+            break;
+
+        case Priority::HIGH:
+            mTasks[static_cast<size_t>(aPriority)].PushFront(std::move(aJob));
+            break;
+
+        default:
+            return false;
+        }
+
+        AddPending(1);
+        mTasksCount.fetch_add(1, std::memory_order_relaxed);
+        UpdateQueueDepth();
+        return true;
+    }
+
+    void AddPending(const size_t aCount) noexcept
+    {
+        if (mPending)
+        {
+            mPending->fetch_add(aCount);
+        }
+    }
+
+    // wakes up the drainers when the last task of the group is done
+    void DonePending() noexcept
+    {
+        if (mPending && mPending->fetch_sub(1) == 1)
+        {
+            mPending->notify_all();
+        }
+    }
+
+    void UpdateQueueDepth() noexcept
+    {
+        if constexpr (THREAD_POOL_METRICS)
+        {
+            const uint64_t depth = TaskCount();
+            auto depthMax = mMetrics.queueDepthMax.load(std::memory_order_relaxed);
+            while (depth > depthMax &&
+                   !mMetrics.queueDepthMax.compare_exchange_weak(depthMax, depth, std::memory_order_relaxed))
+            {
+            }
+        }
+    }
+
+    void Trace(const char *aName, const std::chrono::steady_clock::time_point aStart,
+               const std::chrono::nanoseconds aDuration) const
+    {
+        if (mTrace)
+        {
+            mTrace({aName, mIndex, aStart, aDuration});
+        }
+    }
+
+    // runs the job, on the calling worker's metrics, or on this thread's if called from outside the pool
+    void Execute(Job &aJob)
+    {
+#if THREAD_POOL_METRICS
+        const auto thread = sCurrent ? sCurrent : this;
+        const auto start = std::chrono::steady_clock::now();
+        thread->mMetrics.queueWait.Record(start - aJob.QueuedAt());
+
+        aJob();
+
+        const auto duration = std::chrono::steady_clock::now() - start;
+        thread->mMetrics.runTime.Record(duration);
+        thread->mMetrics.busyNanoseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+        thread->mMetrics.tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+        thread->Trace("task", start, duration);
+#else
+        aJob();
+#endif // THREAD_POOL_METRICS
+
+        DonePending();
+    }
+
+    // the highest priority first, unless a lower one waited for too long, expects the lock and a task
+    Job TakeFront()
+    {
+        size_t chosen = mTasks.size();
+        for (size_t i = 0; i < mTasks.size(); i++)
+        {
+            if (!mTasks[i].Empty() && mTasksSkipped[i] >= AGING_LIMIT)
+            {
+                chosen = i;
+                break;
+            }
+        }
+
+        if (chosen == mTasks.size())
+        {
+            for (chosen = mTasks.size() - 1; mTasks[chosen].Empty(); chosen--)
+            {
+            }
+        }
+
+        for (size_t i = 0; i < chosen; i++)
+        {
+            mTasksSkipped[i] += !mTasks[i].Empty();
+        }
+        mTasksSkipped[chosen] = 0;
+
+        mTasksCount.fetch_sub(1, std::memory_order_relaxed);
+        return mTasks[chosen].PopFront();
+    }
+
+    // the lowest priority and newest task, for the thieves, expects the lock and a task
+    Job TakeBack()
+    {
+        size_t chosen{};
+        for (; mTasks[chosen].Empty(); chosen++)
+        {
+        }
+
+        mTasksCount.fetch_sub(1, std::memory_order_relaxed);
+        return mTasks[chosen].PopBack();
+    }
+
+    static void Relax() noexcept
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // returns true if the thread was parked and had to be woken up
+    bool Notify()
+    {
+        mSignal.fetch_add(1);
+        if (!mParked.load())
+        {
+            return false;
+        }
+
+        mSignal.notify_one();
+        return true;
+    }
+
+    void NotifySibling()
+    {
+        if (!mSiblings)
+        {
+            return;
+        }
+
+        for (auto &sibling : *mSiblings)
+        {
+            if (&sibling != this && sibling.mParked.load() && sibling.Notify())
+            {
+                return;
+            }
+        }
+    }
+
+    bool HasStealable()
+    {
+        for (const auto &sibling : *mSiblings)
+        {
+            if (sibling.mDeque.Size())
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // blocks until the signal moves past aSignal
+    void Idle(const uint32_t aSignal)
+    {
+        if (mWait == Wait::SPIN_THEN_PARK)
+        {
+            for (uint32_t i = 0; i < mSpinLimit; i++)
+            {
+                if (mSignal.load(std::memory_order_relaxed) != aSignal || (mSiblings && HasStealable()))
+                {
+                    // the spin paid off, allow a longer one next time
+                    mSpinLimit = std::min(mSpinLimit * 2, SPIN_LIMIT_MAX);
+                    return;
+                }
+
+                Relax();
+            }
+
+            mSpinLimit = std::max(mSpinLimit / 2, SPIN_LIMIT_MIN);
+        }
+
+        mParked.store(true);
+
+        // a sibling may have pushed work before it could see us parked
+        if (!mSiblings || !HasStealable())
+        {
+            mIdleSince.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+#if THREAD_POOL_METRICS
+            const auto start = std::chrono::steady_clock::now();
+            mSignal.wait(aSignal);
+
+            const auto duration = std::chrono::steady_clock::now() - start;
+            mMetrics.idleNanoseconds.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+            Trace("idle", start, duration);
+#else
+            mSignal.wait(aSignal);
+#endif // THREAD_POOL_METRICS
+
+            mIdleSince.store(0, std::memory_order_relaxed);
+        }
+
+        mParked.store(false);
+    }
+
+    // owner only, the slot is given back once its job is taken
+    SlotPool<Job>::Slot *Store(Job &&aJob)
+    {
+        const auto slot = mSlots.Take();
+        slot->item = std::move(aJob);
+        return slot;
+    }
+
+    bool TakeOwn(Job &aJob)
+    {
+        // the newest local task first, its data is still in cache
+        if (const auto task = mDeque.Pop())
+        {
+            aJob = std::move((*task)->item);
+            mSlots.Give(*task);
+            return true;
+        }
+
+        std::unique_lock lock(mMutexTasks, std::try_to_lock);
+        if (!lock || !mTasksCount)
+        {
+            return false;
+        }
+
+        aJob = TakeFront();
+        return true;
+    }
+
+    bool TakeStolen(Job &aJob)
+    {
+        // the oldest task, the owner is the least likely to touch it soon
+        if (const auto task = mDeque.Steal())
+        {
+            aJob = std::move((*task)->item);
+            mSlots.GiveBack(*task);
+            return true;
+        }
+
+        std::unique_lock lock(mMutexTasks, std::try_to_lock);
+        if (!lock || !mTasksCount)
+        {
+            return false;
+        }
+
+        aJob = TakeBack();
+        return true;
+    }
+
+    bool Steal(Job &aJob)
+    {
+        const auto count = mSiblings->size();
+        const auto self = static_cast<size_t>(this - mSiblings->data());
+
+        // the same node first, its memory is local, then across the nodes
+        for (const auto sameNode : {true, false})
+        {
+            // start after ourselves so the thieves spread over the victims
+            for (size_t i = 1; i < count; i++)
+            {
+                auto &sibling = (*mSiblings)[(self + i) % count];
+                if ((sibling.mNode == mNode) == sameNode && sibling.TakeStolen(aJob))
+                {
+                    if constexpr (THREAD_POOL_METRICS)
+                    {
+                        mMetrics.steals.fetch_add(1, std::memory_order_relaxed);
+                    }
+
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool IsRetiring() const noexcept
+    {
+        return mRetirement.load() == Retirement::RETIRING;
+    }
+
+    // false if the thread was started again meanwhile and has to stay
+    bool Leave() noexcept
+    {
+        auto retiring = Retirement::RETIRING;
+        return mRetirement.compare_exchange_strong(retiring, Retirement::LEFT);
+    }
+
+    void RunStealing()
+    {
+        Job job;
+        while (mRunning)
+        {
+            const auto signal = mSignal.load();
+            if (!TakeOwn(job) && (IsRetiring() || !Steal(job)))
+            {
+                // a retiring thread finishes its own tasks but does not steal new ones
+                if (IsRetiring())
+                {
+                    if (Leave())
+                    {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                Idle(signal);
+                continue;
+            }
+
+            Execute(job);
+        }
+    }
+
+    void Run()
+    {
+        sCurrent = this;
+        if (!mCpus.empty())
+        {
+            Topology::Pin(mCpus);
+        }
+
+        if (mSiblings)
+        {
+            RunStealing();
+            mRunning = false;
+            return;
+        }
+
+        while (mRunning)
+        {
+            // wait for work
+            const auto signal = mSignal.load();
+            if (mRunning && !HasWork())
+            {
+                if (IsRetiring())
+                {
+                    if (Leave())
+                    {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                Idle(signal);
+                continue;
+            }
+
+            // lock and check again
+            std::unique_lock lock(mMutexTasks);
+            if (!mRunning || !HasWork())
+            {
+                // no more work, go wait again
+                lock.unlock();
+                continue;
+            }
+
+            // get the task and unlock
+            Job job(TakeFront());
+
+            lock.unlock();
+
+            // work
+            Execute(job);
+        }
+
+        mRunning = false;
+    }
+};
+
+class ThreadPool;
+
+template <typename Type> class Future;
+template <typename Type> class Promise;
+
+// the state shared by a Promise and its Future, reference counted intrusively to need a single allocation
+template <typename Type> class FutureState
+{
+  public:
+    using Value = std::conditional_t<std::is_void_v<Type>, std::monostate, Type>;
+
+    explicit FutureState(ThreadPool *aPool) noexcept : mPool(aPool)
+    {
+    }
+
+    ThreadPool *GetPool() const noexcept
+    {
+        return mPool;
+    }
+
+    void AddReference() noexcept
+    {
+        mReferences.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release() noexcept
+    {
+        if (mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    template <typename... Args> void SetValue(Args &&...aArgs)
+    {
+        mValue.emplace(std::forward<Args>(aArgs)...);
+        Complete();
+    }
+
+    void SetException(std::exception_ptr aException)
+    {
+        mException = std::move(aException);
+        Complete();
+    }
+
+    bool IsReady() const noexcept
+    {
+        return mStatus.load(std::memory_order_acquire) == Status::READY;
+    }
+
+    void Wait() const noexcept
+    {
+        for (auto status = mStatus.load(std::memory_order_acquire); status != Status::READY;
+             status = mStatus.load(std::memory_order_acquire))
+        {
+            mStatus.wait(status, std::memory_order_acquire);
+        }
+    }
+
+    Value Take()
+    {
+        Wait();
+        if (mException)
+        {
+            std::rethrow_exception(mException);
+        }
+
+        return std::move(*mValue);
+    }
+
+    // runs aJob once ready, on the worker that made it ready
+    void OnReady(Job &&aJob)
+    {
+        mContinuation = std::move(aJob);
+
+        auto expected = Status::PENDING;
+        if (!mStatus.compare_exchange_strong(expected, Status::CONTINUATION, std::memory_order_acq_rel))
+        {
+            // already ready, nobody else will look at the continuation
+            Schedule(std::move(mContinuation));
+        }
+    }
+
+  private:
+    enum class Status : uint8_t
+    {
+        PENDING,
+        CONTINUATION,
+        READY
+    };
+
+    std::atomic<Status> mStatus{Status::PENDING};
+    std::atomic_uint32_t mReferences{1};
+
+    ThreadPool *mPool{};
+    Thread *mThread{}; // the worker that made the state ready
+
+    std::optional<Value> mValue{};
+    std::exception_ptr mException{};
+    Job mContinuation{};
+
+    void Complete()
+    {
+        mThread = Thread::Current();
+
+        const auto previous = mStatus.exchange(Status::READY, std::memory_order_acq_rel);
+        mStatus.notify_all();
+
+        if (previous == Status::CONTINUATION)
+        {
+            Schedule(std::move(mContinuation));
+        }
+    }
+
+    void Schedule(Job &&aJob);
+};
+
+// move only handle to a result computed on a ThreadPool, lighter than std::future (no mutex, no shared_ptr)
+template <typename Type> class Future
+{
+  public:
+    constexpr Future() noexcept = default;
+
+    explicit Future(FutureState<Type> *aState) noexcept : mState(aState)
+    {
+    }
+
+    Future(Future &&aFuture) noexcept : mState(std::exchange(aFuture.mState, nullptr))
+    {
+    }
+
+    Future &operator=(Future &&aFuture) noexcept
+    {
+        if (this != &aFuture)
+        {
+            Reset();
+            mState = std::exchange(aFuture.mState, nullptr);
+        }
+
+        return *this;
+    }
+
+    Future(const Future &) = delete;
+    Future &operator=(const Future &) = delete;
+
+    ~Future()
+    {
+        Reset();
+    }
+
+    // false if the task could not be submitted
+    bool Valid() const noexcept
+    {
+        return mState;
+    }
+
+    // an invalid future is ready, Get throws
+    bool IsReady() const noexcept
+    {
+        return !mState || mState->IsReady();
+    }
+
+    ThreadPool *GetPool() const noexcept
+    {
+        return mState ? mState->GetPool() : nullptr;
+    }
+
+    // blocks, avoid it on a worker thread and prefer Then
+    void Wait() const noexcept
+    {
+        if (mState)
+        {
+            mState->Wait();
+        }
+    }
+
+    // blocks, rethrows the exception of the task if any
+    Type Get()
+    {
+        if (!mState)
+        {
+            throw std::runtime_error("Invalid future!");
+        }
+
+        auto state = std::exchange(mState, nullptr);
+        struct Releaser
+        {
+            FutureState<Type> *state;
+            ~Releaser()
+            {
+                state->Release();
+            }
+        } releaser{state};
+
+        if constexpr (std::is_void_v<Type>)
+        {
+            state->Take();
+        }
+        else
+        {
+            return state->Take();
+        }
+    }
+
+    // runs aFunction(result) on the worker that produced the result, consumes this future
+    template <typename Function> auto Then(Function &&aFunction)
+    {
+        using Result =
+            typename std::conditional_t<std::is_void_v<Type>, std::invoke_result<std::decay_t<Function> &>,
+                                        std::invoke_result<std::decay_t<Function> &, Type>>::type;
+
+        Promise<Result> promise(GetPool());
+        auto future = promise.GetFuture();
+
+        Subscribe([promise = std::move(promise),
+                   function = std::forward<Function>(aFunction)](Future<Type> aReady) mutable {
+            promise.Run([&] {
+                if constexpr (std::is_void_v<Type>)
+                {
+                    aReady.Get();
+                    return std::invoke(function);
+                }
+                else
+                {
+                    return std::invoke(function, aReady.Get());
+                }
+            });
+        });
+
+        return future;
+    }
+
+    // runs aFunction(readyFuture) once ready, consumes this future, an invalid one is ready with an exception
+    template <typename Function> void Subscribe(Function &&aFunction)
+    {
+        if (!mState)
+        {
+            Promise<Type> promise(nullptr);
+            promise.SetException(std::make_exception_ptr(std::runtime_error("Invalid future!")));
+            *this = promise.GetFuture();
+        }
+
+        auto state = std::exchange(mState, nullptr);
+
+        // a continuation dropped without running still releases the state
+        state->OnReady([ready = Future<Type>(state), function = std::forward<Function>(aFunction)]() mutable {
+            function(std::move(ready));
+        });
+    }
+
+  private:
+    FutureState<Type> *mState{};
+
+    void Reset() noexcept
+    {
+        if (mState)
+        {
+            std::exchange(mState, nullptr)->Release();
+        }
+    }
+};
+
+// the producing side of a Future, a promise destroyed before being set breaks its future
+template <typename Type> class Promise
+{
+  public:
+    explicit Promise(ThreadPool *aPool) : mState(new FutureState<Type>(aPool))
+    {
+    }
+
+    Promise(Promise &&aPromise) noexcept
+        : mState(std::exchange(aPromise.mState, nullptr)), mSet(std::exchange(aPromise.mSet, true))
+    {
+    }
+
+    Promise(const Promise &) = delete;
+    Promise &operator=(const Promise &) = delete;
+    Promise &operator=(Promise &&) = delete;
+
+    ~Promise()
+    {
+        if (!mState)
+        {
+            return;
+        }
+
+        if (!mSet)
+        {
+            mState->SetException(std::make_exception_ptr(std::runtime_error("Broken promise!")));
+        }
+
+        mState->Release();
+    }
+
+    Future<Type> GetFuture() noexcept
+    {
+        mState->AddReference();
+        return Future<Type>(mState);
+    }
+
+    template <typename... Args> void SetValue(Args &&...aArgs)
+    {
+        mSet = true;
+        mState->SetValue(std::forward<Args>(aArgs)...);
+    }
+
+    void SetException(std::exception_ptr aException)
+    {
+        mSet = true;
+        mState->SetException(std::move(aException));
+    }
+
+    // sets the result of aFunction(), or the exception it threw
+    template <typename Function> void Run(Function &&aFunction)
+    {
+        try
+        {
+            if constexpr (std::is_void_v<Type>)
+            {
+                aFunction();
+                SetValue();
+            }
+            else
+            {
+                SetValue(aFunction());
+            }
+        }
+        catch (...)
+        {
+            SetException(std::current_exception());
+        }
+    }
+
+  private:
+    FutureState<Type> *mState{};
+    bool mSet{};
+};
+
+class ThreadPool
+{
+  public:
+    enum class Scheduler : uint8_t
+    {
+        SHARING, // the task goes to the most free thread
+        STEALING // the task goes to any thread and the idle threads steal from the busy ones
+    };
+
+    enum class Affinity : uint8_t
+    {
+        NONE, // the OS places the threads, they all belong to node 1
+        CPU,  // each thread pinned to a single CPU, spread over the NUMA nodes
+        NODE  // each thread pinned to all the CPUs of its NUMA node
+    };
+
+    struct Options
+    {
+        Thread::Priority priority = Thread::Priority::LOW;
+        size_t threadIndex = 0; // 0 == most free thread
+        size_t nodeIndex = 0;   // 0 == any node, otherwise the most free thread of that node
+    };
+
+    struct Config
+    {
+        Scheduler scheduler = Scheduler::SHARING;
+        Thread::Wait wait = Thread::Wait::PARK;
+
+        Affinity affinity = Affinity::NONE;
+        std::vector<size_t> cpus{}; // the CPUs allowed for the affinity, all if empty
+
+        // called by the workers for every task and idle period, only with THREAD_POOL_METRICS
+        std::function<void(const TraceEvent &)> trace{};
+
+        // the pool grows and shrinks between these on its own, 0 == the initial count, so fixed by default
+        size_t threadsMin = 0;
+        size_t threadsMax = 0;
+
+        size_t backlogPerThread = 64;                  // grows while more tasks than this wait per thread
+        std::chrono::milliseconds idleTimeout{1'000};  // shrinks once the last thread was parked for this long
+        std::chrono::milliseconds resizePeriod{10};    // how often the backlog and the idle time are sampled
+    };
+
+    ThreadPool(const bool aStart = false, const size_t aThreadsCount = 2) : ThreadPool(aStart, aThreadsCount, Config())
+    {
+    }
+
+    ThreadPool(const bool aStart, const size_t aThreadsCount, const Config &aConfig)
+        : mThreads(std::max(aThreadsCount, aConfig.threadsMax)), mConfig(aConfig), mActive(aThreadsCount),
+          mThreadsMin(aConfig.threadsMin ? std::min(aConfig.threadsMin, aThreadsCount) : aThreadsCount),
+          mThreadsMax(std::max(aConfig.threadsMax, aThreadsCount)), mIndices(mThreads.size())
+    {
+        std::iota(mIndices.begin(), mIndices.end(), size_t{});
+
+        for (size_t i = 0; i < mThreads.size(); i++)
+        {
+            auto &thread = mThreads[i];
+            thread.SetTrace(i, mConfig.trace);
+            thread.SetWait(mConfig.wait);
+            thread.SetPending(&mPending);
+            if (mConfig.scheduler == Scheduler::STEALING)
+            {
+                thread.SetSiblings(&mThreads);
+            }
+        }
+
+        Place();
+
+        if (aStart)
+        {
+            Start();
+        }
+    }
+
+    bool Add(Thread::Task &&aTask)
+    {
+        return Add(std::move(aTask), Options());
+    }
+
+    bool Add(Thread::Task &&aTask, const Options &aOptions)
+    {
+        return Dispatch(Thread::ToJob(std::move(aTask)), aOptions);
+    }
+
+    bool Add(Job &&aJob)
+    {
+        return Dispatch(std::move(aJob), Options());
+    }
+
+    bool Add(Job &&aJob, const Options &aOptions)
+    {
+        return Dispatch(std::move(aJob), aOptions);
+    }
+
+    // distributes the tasks over the threads in a single pass, locking each thread once, returns how many were added
+    size_t AddBatch(const std::span<Thread::Task> aTasks)
+    {
+        return AddBatch(aTasks.begin(), aTasks.end(), Options());
+    }
+
+    size_t AddBatch(const std::span<Thread::Task> aTasks, const Options &aOptions)
+    {
+        return AddBatch(aTasks.begin(), aTasks.end(), aOptions);
+    }
+
+    // the elements are Thread::Tasks or callables, they are moved from
+    template <std::input_iterator Iterator> size_t AddBatch(Iterator aFirst, const Iterator aLast)
+    {
+        return AddBatch(aFirst, aLast, Options());
+    }
+
+    template <std::input_iterator Iterator>
+    size_t AddBatch(Iterator aFirst, const Iterator aLast, const Options &aOptions)
+    {
+        std::vector<Job> jobs;
+        if constexpr (std::random_access_iterator<Iterator>)
+        {
+            jobs.reserve(static_cast<size_t>(aLast - aFirst));
+        }
+
+        for (; aFirst != aLast; aFirst++)
+        {
+            if constexpr (std::same_as<std::iter_value_t<Iterator>, Thread::Task>)
+            {
+                jobs.emplace_back(Thread::ToJob(std::move(*aFirst)));
+            }
+            else
+            {
+                jobs.emplace_back(std::move(*aFirst));
+            }
+        }
+
+        return DispatchBatch(jobs, aOptions);
+    }
+
+    // runs aFunction(aArgs...) on the pool, the arguments are moved in, no std::any involved
+    template <typename Function, typename... Args>
+        requires std::invocable<std::decay_t<Function> &, std::decay_t<Args> &...>
+    auto Submit(Function &&aFunction, Args &&...aArgs)
+    {
+        return Submit(Options(), std::forward<Function>(aFunction), std::forward<Args>(aArgs)...);
+    }
+
+    // the returned future is not valid if the options are
+    template <typename Function, typename... Args>
+        requires std::invocable<std::decay_t<Function> &, std::decay_t<Args> &...>
+    auto Submit(const Options &aOptions, Function &&aFunction, Args &&...aArgs)
+    {
+        using Result = std::invoke_result_t<std::decay_t<Function> &, std::decay_t<Args> &...>;
+
+        Promise<Result> promise(this);
+        auto future = promise.GetFuture();
+
+        Job job([promise = std::move(promise), function = std::forward<Function>(aFunction),
+                 ... args = std::forward<Args>(aArgs)]() mutable {
+            promise.Run([&] { return std::invoke(function, args...); });
+        });
+
+        if (!Dispatch(std::move(job), aOptions))
+        {
+            return Future<Result>();
+        }
+
+        return future;
+    }
+
+    // co_await pool.Schedule() resumes the coroutine on a worker, or right away if the options are not valid
+    auto Schedule(const Options &aOptions) noexcept
+    {
+        struct Awaiter
+        {
+            ThreadPool *pool;
+            Options options;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            // the coroutine may already run on the worker when this returns
+            bool await_suspend(const std::coroutine_handle<> aHandle) const
+            {
+                return pool->Dispatch([aHandle] { aHandle.resume(); }, options);
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        return Awaiter{this, aOptions};
+    }
+
+    auto Schedule() noexcept
+    {
+        return Schedule(Options());
+    }
+
+    // dispatches aJob after aDelay from the timer thread, no worker waits for it
+    TimerWheel::Timer AddAfter(const std::chrono::nanoseconds aDelay, Job &&aJob)
+    {
+        return AddAfter(aDelay, std::move(aJob), Options());
+    }
+
+    TimerWheel::Timer AddAfter(const std::chrono::nanoseconds aDelay, Job &&aJob, const Options &aOptions)
+    {
+        if (!IsValid(aOptions))
+        {
+            return {};
+        }
+
+        return mTimers.Add(aDelay, {}, [this, aOptions, job = std::move(aJob)]() mutable {
+            Dispatch(std::move(job), aOptions);
+        });
+    }
+
+    TimerWheel::Timer AddAfter(const std::chrono::nanoseconds aDelay, Thread::Task &&aTask)
+    {
+        return AddAfter(aDelay, Thread::ToJob(std::move(aTask)), Options());
+    }
+
+    TimerWheel::Timer AddAfter(const std::chrono::nanoseconds aDelay, Thread::Task &&aTask, const Options &aOptions)
+    {
+        return AddAfter(aDelay, Thread::ToJob(std::move(aTask)), aOptions);
+    }
+
+    // dispatches aJob every aPeriod, the first time after one period, a period is skipped while the last run is going
+    TimerWheel::Timer AddEvery(const std::chrono::nanoseconds aPeriod, Job &&aJob)
+    {
+        return AddEvery(aPeriod, std::move(aJob), Options());
+    }
+
+    TimerWheel::Timer AddEvery(const std::chrono::nanoseconds aPeriod, Job &&aJob, const Options &aOptions)
+    {
+        if (aPeriod.count() <= 0 || !IsValid(aOptions))
+        {
+            return {};
+        }
+
+        struct Periodic
+        {
+            explicit Periodic(Job &&aJob) : job(std::move(aJob))
+            {
+            }
+
+            Job job;
+            std::atomic_flag running{};
+        };
+
+        auto periodic = std::make_shared<Periodic>(std::move(aJob));
+        return mTimers.Add(aPeriod, aPeriod, [this, aOptions, periodic = std::move(periodic)] {
+            if (periodic->running.test_and_set())
+            {
+                return;
+            }
+
+            if (!Dispatch(
+                    [periodic] {
+                        periodic->job();
+                        periodic->running.clear();
+                    },
+                    aOptions))
+            {
+                periodic->running.clear();
+            }
+        });
+    }
+
+    TimerWheel::Timer AddEvery(const std::chrono::nanoseconds aPeriod, Thread::Task &&aTask)
+    {
+        return AddEvery(aPeriod, Thread::ToJob(std::move(aTask)), Options());
+    }
+
+    TimerWheel::Timer AddEvery(const std::chrono::nanoseconds aPeriod, Thread::Task &&aTask, const Options &aOptions)
+    {
+        return AddEvery(aPeriod, Thread::ToJob(std::move(aTask)), aOptions);
+    }
+
+    // runs one pending task on the calling thread, used to help instead of blocking while waiting
+    bool RunOne()
+    {
+        const auto current = Thread::Current();
+        if (current && IsOwn(*current) && current->RunOne())
+        {
+            return true;
+        }
+
+        for (auto &thread : mThreads)
+        {
+            if (&thread != current && thread.RunStolen())
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // the active threads, the ones the tasks are dispatched to
+    size_t ThreadsCount() const noexcept
+    {
+        return mActive;
+    }
+
+    // the queued and running tasks
+    size_t PendingCount() const noexcept
+    {
+        return mPending;
+    }
+
+    // between 1 and the initial count or Config::threadsMax, the retired threads finish their own tasks first
+    bool Resize(const size_t aThreadsCount)
+    {
+        if (!aThreadsCount || aThreadsCount > mThreads.size())
+        {
+            return false;
+        }
+
+        std::scoped_lock lock(mResizeMutex);
+
+        const auto active = mActive.load();
+        if (aThreadsCount > active)
+        {
+            if (mStarted)
+            {
+                for (size_t i = active; i < aThreadsCount; i++)
+                {
+                    mThreads[i].Start();
+                }
+            }
+
+            mActive = aThreadsCount;
+        }
+        else if (aThreadsCount < active)
+        {
+            // no new tasks for them from here on
+            mActive = aThreadsCount;
+
+            if (mStarted)
+            {
+                for (size_t i = aThreadsCount; i < active; i++)
+                {
+                    mThreads[i].Retire();
+                }
+
+                // a task may still race in after its thread left, the supervisor moves it to an active one
+                StartSupervisor();
+            }
+        }
+
+        return true;
+    }
+
+    // waits until every queued task ran, including the ones they add, not from a worker of this pool
+    void Drain()
+    {
+        for (auto pending = mPending.load(); pending; pending = mPending.load())
+        {
+            mPending.wait(pending);
+        }
+    }
+
+    size_t NodesCount() const noexcept
+    {
+        return mNodes.size();
+    }
+
+    // all zeros unless compiled with THREAD_POOL_METRICS
+    const Thread::Metrics &GetMetrics(const size_t aThreadIndex) const
+    {
+        return mThreads.at(aThreadIndex).GetMetrics();
+    }
+
+    // schedules a continuation on aThread (the one that ran the task before it) to keep its data in cache
+    void Continue(Thread *aThread, Job &&aJob)
+    {
+        if (!aThread || !IsActive(*aThread))
+        {
+            Dispatch(std::move(aJob), Options());
+        }
+        else if (aThread == Thread::Current() && mConfig.scheduler == Scheduler::STEALING)
+        {
+            aThread->Push(std::move(aJob));
+        }
+        else
+        {
+            aThread->Add(std::move(aJob), Thread::Priority::HIGH);
+        }
+    }
+
+    void Start()
+    {
+        std::scoped_lock lock(mResizeMutex);
+
+        for (size_t i = 0; i < mActive; i++)
+        {
+            mThreads[i].Start();
+        }
+        mStarted = true;
+
+        if (mThreadsMin != mThreadsMax)
+        {
+            StartSupervisor();
+        }
+
+        mTimers.Start();
+    }
+
+    // right away, the queued tasks are left for a later Start
+    void Stop()
+    {
+        // the timers are kept for a later Start
+        mTimers.Stop();
+
+        {
+            std::scoped_lock lock(mResizeMutex);
+            mStarted = false;
+
+            std::scoped_lock lockSupervisor(mSupervisorMutex);
+            mSupervising = false;
+        }
+        mSupervisorWake.notify_one();
+
+        if (mSupervisor.joinable())
+        {
+            mSupervisor.join();
+        }
+
+        for (auto &thread : mThreads)
+        {
+            thread.Stop();
+        }
+    }
+
+    // runs every task, including the ones added meanwhile, then stops
+    void StopAfterCompletion()
+    {
+        Drain();
+        Stop();
+    }
+
+    ~ThreadPool()
+    {
+        Stop();
+        Drop();
+    }
+
+  private:
+    std::vector<Thread> mThreads{};
+    Config mConfig{};
+
+    // the first mActive threads get the tasks, the others are retired or were never started
+    std::atomic_size_t mActive{};
+    size_t mThreadsMin{};
+    size_t mThreadsMax{};
+    std::atomic_size_t mPending{};
+
+    std::mutex mResizeMutex{};
+    bool mStarted{};
+
+    // samples the load and resizes the pool
+    std::thread mSupervisor{};
+    std::mutex mSupervisorMutex{};
+    std::condition_variable mSupervisorWake{};
+    bool mSupervising{};
+
+    std::atomic_size_t mThreadNext{};
+
+    // 0 to the capacity, a prefix of it is the active threads of any node
+    std::vector<size_t> mIndices{};
+
+    // the indices of the threads of each node, sorted
+    std::vector<std::vector<size_t>> mNodes{};
+
+    // how many samples in a row the backlog has to be too long for, before growing
+    static constexpr size_t GROW_SAMPLES = 3;
+
+    // services AddAfter and AddEvery on its own thread, stopped before the workers
+    TimerWheel mTimers{};
+
+    void Place()
+    {
+        if (mConfig.affinity == Affinity::NONE)
+        {
+            auto &node = mNodes.emplace_back(mThreads.size());
+            std::iota(node.begin(), node.end(), size_t{});
+            return;
+        }
+
+        std::vector<std::vector<size_t>> nodes;
+        for (auto &cpus : Topology::Nodes())
+        {
+            std::erase_if(cpus, [this](const size_t aCpu) {
+                return !mConfig.cpus.empty() && std::ranges::find(mConfig.cpus, aCpu) == mConfig.cpus.end();
+            });
+
+            if (!cpus.empty())
+            {
+                nodes.emplace_back(std::move(cpus));
+            }
+        }
+
+        mNodes.resize(nodes.size());
+        for (size_t i = 0; i < mThreads.size(); i++)
+        {
+            // round robin over the nodes, then over the CPUs of each node
+            const auto node = i % nodes.size();
+            const auto &cpus = nodes[node];
+
+            if (mConfig.affinity == Affinity::CPU)
+            {
+                mThreads[i].SetPlacement(node, {cpus[(i / nodes.size()) % cpus.size()]});
+            }
+            else
+            {
+                mThreads[i].SetPlacement(node, cpus);
+            }
+
+            mNodes[node].push_back(i);
+        }
+
+        // more nodes than threads
+        std::erase_if(mNodes, [](const std::vector<size_t> &aThreads) { return aThreads.empty(); });
+    }
+
+    // expects the resize lock
+    void StartSupervisor()
+    {
+        {
+            std::scoped_lock lock(mSupervisorMutex);
+            if (mSupervising)
+            {
+                return;
+            }
+            mSupervising = true;
+        }
+
+        if (mSupervisor.joinable())
+        {
+            mSupervisor.join();
+        }
+
+        mSupervisor = std::thread(std::bind(&ThreadPool::Supervise, this));
+    }
+
+    void Supervise()
+    {
+        size_t busySamples{};
+
+        std::unique_lock lock(mSupervisorMutex);
+        while (!mSupervisorWake.wait_for(lock, mConfig.resizePeriod, [this] { return !mSupervising; }))
+        {
+            lock.unlock();
+            Rescue();
+
+            // a fixed size pool shrunk by hand only has its tasks rescued, growing it back would undo the Resize
+            if (mThreadsMin == mThreadsMax)
+            {
+                lock.lock();
+                continue;
+            }
+
+            const auto active = mActive.load();
+            size_t backlog{};
+            for (size_t i = 0; i < active; i++)
+            {
+                backlog += mThreads[i].TaskCount();
+            }
+
+            if (backlog > active * mConfig.backlogPerThread)
+            {
+                if (++busySamples >= GROW_SAMPLES && active < mThreadsMax)
+                {
+                    Resize(active + 1);
+                    busySamples = 0;
+                }
+            }
+            else
+            {
+                busySamples = 0;
+
+                // the last thread is the one to go, it is also the last to get the tasks
+                if (active > mThreadsMin && mThreads[active - 1].IdleFor() >= mConfig.idleTimeout)
+                {
+                    Resize(active - 1);
+                }
+            }
+
+            lock.lock();
+        }
+    }
+
+    // the tasks left queued break their promises, whose continuations are queued in turn, all of them dropped while the
+    // threads and the nodes they are dispatched through are still there
+    void Drop()
+    {
+        mTimers.Clear();
+
+        for (auto dropped = true; dropped;)
+        {
+            dropped = false;
+
+            Job job;
+            for (auto &thread : mThreads)
+            {
+                while (thread.Evict(job))
+                {
+                    job.Reset();
+                    dropped = true;
+                }
+            }
+        }
+    }
+
+    // moves the tasks left on the retired threads that already exited to the active ones
+    void Rescue()
+    {
+        Job job;
+        for (size_t i = mActive; i < mThreads.size(); i++)
+        {
+            while (!mThreads[i].IsRunning() && mThreads[i].Evict(job))
+            {
+                // counted again once dispatched, so the pending count never drops to zero in between, but it may once
+                // the job ran already, Drain waits for that
+                Dispatch(std::move(job), Options());
+                if (mPending.fetch_sub(1) == 1)
+                {
+                    mPending.notify_all();
+                }
+            }
+        }
+    }
+
+    bool IsOwn(const Thread &aThread) const noexcept
+    {
+        return !mThreads.empty() && &aThread >= mThreads.data() && &aThread < mThreads.data() + mThreads.size();
+    }
+
+    bool IsActive(const Thread &aThread) const noexcept
+    {
+        return IsOwn(aThread) && static_cast<size_t>(&aThread - mThreads.data()) < mActive;
+    }
+
+    // the active threads of the node, of any node if aNodeIndex is 0 or none of the node's threads is active
+    std::span<const size_t> Candidates(const size_t aNodeIndex) const
+    {
+        const auto active = mActive.load();
+        if (aNodeIndex)
+        {
+            const auto &node = mNodes[aNodeIndex - 1];
+            const auto count = static_cast<size_t>(std::ranges::lower_bound(node, active) - node.begin());
+            if (count)
+            {
+                return {node.data(), count};
+            }
+        }
+
+        return {mIndices.data(), active};
+    }
+
+    bool IsValid(const Options &aOptions) const noexcept
+    {
+        return aOptions.threadIndex <= mActive && aOptions.nodeIndex <= mNodes.size();
+    }
+
+    bool Dispatch(Job &&aJob, const Options &aOptions)
+    {
+        if (!IsValid(aOptions))
+        {
+            return false;
+        }
+
+        if (aOptions.threadIndex)
+        {
+            return mThreads[aOptions.threadIndex - 1].Add(std::move(aJob), aOptions.priority);
+        }
+        else if (mConfig.scheduler == Scheduler::STEALING)
+        {
+            // tasks spawned by a worker stay on it, without locking, ignoring the priority
+            const auto current = Thread::Current();
+            if (current && current->IsSibling(&mThreads) &&
+                (!aOptions.nodeIndex || current->GetNode() == aOptions.nodeIndex - 1))
+            {
+                current->Push(std::move(aJob));
+                return true;
+            }
+
+            const auto candidates = Candidates(aOptions.nodeIndex);
+            const auto next = mThreadNext.fetch_add(1, std::memory_order_relaxed);
+            return mThreads[candidates[next % candidates.size()]].Add(std::move(aJob), aOptions.priority);
+        }
+        else
+        {
+            return ChooseThread(aOptions.nodeIndex).Add(std::move(aJob), aOptions.priority);
+        }
+    }
+
+    size_t DispatchBatch(const std::span<Job> aJobs, const Options &aOptions)
+    {
+        if (aJobs.empty() || aOptions.threadIndex > mActive || aOptions.nodeIndex > mNodes.size())
+        {
+            return 0;
+        }
+
+        if (aOptions.threadIndex)
+        {
+            return mThreads[aOptions.threadIndex - 1].AddBatch(aJobs, aOptions.priority);
+        }
+
+        // a worker keeps the whole batch, the idle threads steal it from there
+        const auto current = Thread::Current();
+        if (mConfig.scheduler == Scheduler::STEALING && current && current->IsSibling(&mThreads) &&
+            (!aOptions.nodeIndex || current->GetNode() == aOptions.nodeIndex - 1))
+        {
+            current->PushBatch(aJobs);
+            return aJobs.size();
+        }
+
+        const auto active = Candidates(aOptions.nodeIndex);
+        std::vector<size_t> candidates(active.begin(), active.end());
+
+        if (mConfig.scheduler == Scheduler::SHARING)
+        {
+            // the least busy threads get the first and the bigger slices
+            std::ranges::sort(candidates, [this](const size_t aLeft, const size_t aRight) {
+                return mThreads[aLeft].TaskCount() < mThreads[aRight].TaskCount();
+            });
+        }
+        else
+        {
+            std::ranges::rotate(candidates,
+                                candidates.begin() + mThreadNext.fetch_add(1, std::memory_order_relaxed) %
+                                                         candidates.size());
+        }
+
+        const auto slicesCount = std::min(candidates.size(), aJobs.size());
+        const auto sliceSize = aJobs.size() / slicesCount;
+        const auto remainder = aJobs.size() % slicesCount;
+
+        size_t count{};
+        for (size_t i = 0, offset = 0; i < slicesCount; i++)
+        {
+            const auto size = sliceSize + (i < remainder);
+            count += mThreads[candidates[i]].AddBatch(aJobs.subspan(offset, size), aOptions.priority);
+            offset += size;
+        }
+
+        return count;
+    }
+
+    // the active thread with the fewest tasks, of any node if aNodeIndex is 0
+    Thread &ChooseThread(const size_t aNodeIndex = 0)
+    {
+        const auto candidates = Candidates(aNodeIndex);
+
+        size_t index = candidates.front();
+        for (const auto i : candidates)
+        {
+            if (mThreads[index].TaskCount() > mThreads[i].TaskCount())
+            {
+                index = i;
+            }
+        }
+
+        return mThreads[index];
+    }
+};
+
+template <typename Type> void FutureState<Type>::Schedule(Job &&aJob)
+{
+    if (mPool)
+    {
+        mPool->Continue(mThread, std::move(aJob));
+    }
+    else
+    {
+        // out of the state first, the job may release the last reference to it
+        auto job = std::move(aJob);
+        job();
+    }
+}
+
+// the pool of the first valid future, the continuations run on it
+template <typename Type> ThreadPool *PoolOf(const std::vector<Future<Type>> &aFutures) noexcept
+{
+    const auto valid = std::ranges::find_if(aFutures, &Future<Type>::Valid);
+    return valid != aFutures.end() ? valid->GetPool() : nullptr;
+}
+
+// completes with all the results, in order, or with the first exception, an invalid future is one
+template <typename Type> auto WhenAll(std::vector<Future<Type>> aFutures)
+{
+    using Result = std::conditional_t<std::is_void_v<Type>, void, std::vector<Type>>;
+
+    struct All
+    {
+        All(const size_t aCount, ThreadPool *aPool) : values(aCount), remaining(aCount), promise(aPool)
+        {
+        }
+
+        std::vector<std::optional<typename FutureState<Type>::Value>> values;
+        std::atomic_size_t remaining;
+        std::atomic_flag failed{};
+        Promise<Result> promise;
+    };
+
+    auto all = std::make_shared<All>(aFutures.size(), PoolOf(aFutures));
+    auto future = all->promise.GetFuture();
+
+    if (aFutures.empty())
+    {
+        all->promise.Run([] { return Result(); });
+        return future;
+    }
+
+    for (size_t i = 0; i < aFutures.size(); i++)
+    {
+        aFutures[i].Subscribe([all, i](Future<Type> aReady) {
+            try
+            {
+                if constexpr (std::is_void_v<Type>)
+                {
+                    aReady.Get();
+                    all->values[i].emplace();
+                }
+                else
+                {
+                    all->values[i].emplace(aReady.Get());
+                }
+            }
+            catch (...)
+            {
+                if (!all->failed.test_and_set())
+                {
+                    all->promise.SetException(std::current_exception());
+                }
+            }
+
+            if (all->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1 || all->failed.test())
+            {
+                return;
+            }
+
+            all->promise.Run([&] {
+                if constexpr (!std::is_void_v<Type>)
+                {
+                    Result result;
+                    result.reserve(all->values.size());
+                    for (auto &value : all->values)
+                    {
+                        result.emplace_back(std::move(*value));
+                    }
+
+                    return result;
+                }
+            });
+        });
+    }
+
+    return future;
+}
+
+// completes with the index and the result of the first future to finish, an invalid one finishes with an exception
+template <typename Type> auto WhenAny(std::vector<Future<Type>> aFutures)
+{
+    using Result = std::conditional_t<std::is_void_v<Type>, size_t, std::pair<size_t, Type>>;
+
+    struct Any
+    {
+        explicit Any(ThreadPool *aPool) : promise(aPool)
+        {
+        }
+
+        std::atomic_flag done{};
+        Promise<Result> promise;
+    };
+
+    auto any = std::make_shared<Any>(PoolOf(aFutures));
+    auto future = any->promise.GetFuture();
+
+    for (size_t i = 0; i < aFutures.size(); i++)
+    {
+        aFutures[i].Subscribe([any, i](Future<Type> aReady) {
+            if (any->done.test_and_set())
+            {
+                return;
+            }
+
+            any->promise.Run([&] {
+                if constexpr (std::is_void_v<Type>)
+                {
+                    aReady.Get();
+                    return i;
+                }
+                else
+                {
+                    return Result(i, aReady.Get());
+                }
+            });
+        });
+    }
+
+    return future;
+}
+
+// the return_value or the return_void of Async<Type>::promise_type, a promise type can not have both
+template <typename Type> class AsyncReturn
+{
+  public:
+    void return_value(Type aValue)
+    {
+        mValue.emplace(std::move(aValue));
+    }
+
+  protected:
+    std::optional<Type> mValue{};
+};
+
+template <> class AsyncReturn<void>
+{
+  public:
+    void return_void() noexcept
+    {
+        mValue.emplace();
+    }
+
+  protected:
+    std::optional<std::monostate> mValue{};
+};
+
+// a lazy coroutine, it starts once awaited and resumes its awaiter when done, both by symmetric transfer
+// so that long chains of synchronous completions do not grow the stack, move only
+template <typename Type> class Async
+{
+  public:
+    using Value = std::conditional_t<std::is_void_v<Type>, std::monostate, Type>;
+
+    class promise_type : public AsyncReturn<Type>
+    {
+      public:
+        Async get_return_object() noexcept
+        {
+            return Async(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        auto final_suspend() const noexcept
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                // the awaiting coroutine runs next, on this thread
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> aHandle) const noexcept
+                {
+                    const auto continuation = aHandle.promise().mContinuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+            };
+
+            return Awaiter();
+        }
+
+        void unhandled_exception() noexcept
+        {
+            mException = std::current_exception();
+        }
+
+        void SetContinuation(const std::coroutine_handle<> aContinuation) noexcept
+        {
+            mContinuation = aContinuation;
+        }
+
+        // rethrows the exception of the coroutine if any
+        Value Take()
+        {
+            if (mException)
+            {
+                std::rethrow_exception(mException);
+            }
+
+            return std::move(*this->mValue);
+        }
+
+      private:
+        std::coroutine_handle<> mContinuation{};
+        std::exception_ptr mException{};
+    };
+
+    Async(Async &&aAsync) noexcept : mHandle(std::exchange(aAsync.mHandle, nullptr))
+    {
+    }
+
+    Async &operator=(Async &&aAsync) noexcept
+    {
+        if (this != &aAsync)
+        {
+            Reset();
+            mHandle = std::exchange(aAsync.mHandle, nullptr);
+        }
+
+        return *this;
+    }
+
+    Async(const Async &) = delete;
+    Async &operator=(const Async &) = delete;
+
+    ~Async()
+    {
+        Reset();
+    }
+
+    bool IsReady() const noexcept
+    {
+        return !mHandle || mHandle.done();
+    }
+
+    // co_await task gives the result, or rethrows
+    auto operator co_await() noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return handle.done();
+            }
+
+            // starts the task on this thread
+            std::coroutine_handle<> await_suspend(const std::coroutine_handle<> aContinuation) const noexcept
+            {
+                handle.promise().SetContinuation(aContinuation);
+                return handle;
+            }
+
+            Type await_resume() const
+            {
+                if constexpr (std::is_void_v<Type>)
+                {
+                    handle.promise().Take();
+                }
+                else
+                {
+                    return handle.promise().Take();
+                }
+            }
+        };
+
+        return Awaiter{mHandle};
+    }
+
+    // co_await task.Ready() only waits for it, the result is left for Take
+    auto Ready() noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(const std::coroutine_handle<> aContinuation) const noexcept
+            {
+                handle.promise().SetContinuation(aContinuation);
+                return handle;
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        return Awaiter{mHandle};
+    }
+
+    // expects the task done, rethrows its exception if any
+    Value Take()
+    {
+        return mHandle.promise().Take();
+    }
+
+    // blocks, runs the task on the calling thread until it moves to a pool, avoid it on a worker
+    Type Get();
+
+  private:
+    std::coroutine_handle<promise_type> mHandle{};
+
+    explicit Async(const std::coroutine_handle<promise_type> aHandle) noexcept : mHandle(aHandle)
+    {
+    }
+
+    void Reset() noexcept
+    {
+        if (mHandle)
+        {
+            std::exchange(mHandle, nullptr).destroy();
+        }
+    }
+};
+
+// a coroutine nobody awaits, it starts right away and frees itself once done
+class AsyncDetached
+{
+  public:
+    struct promise_type
+    {
+        AsyncDetached get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+// counts the tasks of a WhenAll down, the last one to finish resumes the awaiting coroutine
+class AsyncLatch
+{
+  public:
+    explicit AsyncLatch(const size_t aCount) noexcept : mCount(aCount + 1)
+    {
+    }
+
+    // co_await latch.Wait(start) runs start() to launch the tasks, and resumes once all of them arrived
+    template <typename Start> auto Wait(Start aStart) noexcept
+    {
+        struct Awaiter
+        {
+            AsyncLatch &latch;
+            Start start;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            // the extra count keeps the tasks from resuming us before we are suspended
+            bool await_suspend(const std::coroutine_handle<> aContinuation)
+            {
+                latch.mContinuation = aContinuation;
+                start();
+                return latch.mCount.fetch_sub(1, std::memory_order_acq_rel) != 1;
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        return Awaiter{*this, std::move(aStart)};
+    }
+
+    // co_await latch.Arrive() ends a detached coroutine, the last one transfers to the waiting coroutine
+    auto Arrive() noexcept
+    {
+        struct Awaiter
+        {
+            AsyncLatch &latch;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(const std::coroutine_handle<> aHandle) const noexcept
+            {
+                const auto continuation = latch.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1
+                                              ? latch.mContinuation
+                                              : std::noop_coroutine();
+                aHandle.destroy();
+                return continuation;
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        return Awaiter{*this};
+    }
+
+  private:
+    std::atomic_size_t mCount;
+    std::coroutine_handle<> mContinuation{};
+};
+
+template <typename Type> AsyncDetached AsyncArrive(Async<Type> &aTask, AsyncLatch &aLatch)
+{
+    co_await aTask.Ready();
+    co_await aLatch.Arrive();
+}
+
+template <typename Type> AsyncDetached AsyncForward(Async<Type> &aTask, Promise<Type> aPromise)
+{
+    try
+    {
+        if constexpr (std::is_void_v<Type>)
+        {
+            co_await aTask;
+            aPromise.SetValue();
+        }
+        else
+        {
+            aPromise.SetValue(co_await aTask);
+        }
+    }
+    catch (...)
+    {
+        aPromise.SetException(std::current_exception());
+    }
+}
+
+template <typename Type> Type Async<Type>::Get()
+{
+    Promise<Type> promise(nullptr);
+    auto future = promise.GetFuture();
+
+    AsyncForward(*this, std::move(promise));
+    return future.Get();
+}
+
+// runs the tasks concurrently, completes with all the results in order, or rethrows the first exception in order
+template <typename... Types> Async<std::tuple<typename Async<Types>::Value...>> WhenAll(Async<Types>... aTasks)
+{
+    AsyncLatch latch(sizeof...(Types));
+    co_await latch.Wait([&] { (AsyncArrive(aTasks, latch), ...); });
+
+    co_return std::tuple<typename Async<Types>::Value...>{aTasks.Take()...};
+}
+
+template <typename Type>
+Async<std::conditional_t<std::is_void_v<Type>, void, std::vector<Type>>> WhenAll(std::vector<Async<Type>> aTasks)
+{
+    AsyncLatch latch(aTasks.size());
+    co_await latch.Wait([&] {
+        for (auto &task : aTasks)
+        {
+            AsyncArrive(task, latch);
+        }
+    });
+
+    if constexpr (std::is_void_v<Type>)
+    {
+        for (auto &task : aTasks)
+        {
+            task.Take();
+        }
+    }
+    else
+    {
+        std::vector<Type> values;
+        values.reserve(aTasks.size());
+        for (auto &task : aTasks)
+        {
+            values.emplace_back(task.Take());
+        }
+
+        co_return values;
+    }
+}
+
+// runs aBody(first, last) over [0, aCount) split recursively in halves down to aGrain, the caller helps until done
+template <typename Body> void ParallelChunks(ThreadPool &aPool, const size_t aCount, size_t aGrain, Body &&aBody)
+{
+    if (!aCount)
+    {
+        return;
+    }
+
+    if (!aGrain)
+    {
+        // a few chunks per thread, so the ones that finish early can steal the rest
+        aGrain = std::max<size_t>(1, aCount / (aPool.ThreadsCount() * 8));
+    }
+
+    struct Context
+    {
+        ThreadPool &pool;
+        const size_t grain;
+        Body &body;
+
+        std::atomic_size_t pending{};
+        std::atomic_flag failed{};
+        std::exception_ptr exception{};
+
+        void Split(size_t aFirst, size_t aLast)
+        {
+            while (aLast - aFirst > grain)
+            {
+                const auto middle = aFirst + (aLast - aFirst) / 2;
+
+                pending.fetch_add(1, std::memory_order_relaxed);
+                pool.Add(Job([this, middle, aLast] {
+                    Split(middle, aLast);
+                    pending.fetch_sub(1, std::memory_order_release);
+                }));
+
+                aLast = middle;
+            }
+
+            try
+            {
+                if (!failed.test(std::memory_order_relaxed))
+                {
+                    body(aFirst, aLast);
+                }
+            }
+            catch (...)
+            {
+                if (!failed.test_and_set())
+                {
+                    exception = std::current_exception();
+                }
+            }
+        }
+    } context{aPool, aGrain, aBody};
+
+    context.Split(0, aCount);
+
+    // help instead of blocking, the caller may be a worker itself
+    while (context.pending.load(std::memory_order_acquire))
+    {
+        if (!aPool.RunOne())
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    if (context.exception)
+    {
+        std::rethrow_exception(context.exception);
+    }
+}
+
+// aFunction(element) for iterators, aFunction(index) for integers
+template <typename Iterator, typename Function>
+void ParallelFor(ThreadPool &aPool, const Iterator aFirst, const Iterator aLast, Function &&aFunction,
+                 const size_t aGrain = 0)
+{
+    ParallelChunks(aPool, static_cast<size_t>(aLast - aFirst), aGrain, [&](const size_t aBegin, const size_t aEnd) {
+        for (auto it = aFirst + aBegin; it != aFirst + aEnd; it++)
+        {
+            if constexpr (std::is_integral_v<Iterator>)
+            {
+                aFunction(it);
+            }
+            else
+            {
+                aFunction(*it);
+            }
+        }
+    });
+}
+
+template <typename InputIterator, typename OutputIterator, typename Function>
+OutputIterator ParallelTransform(ThreadPool &aPool, const InputIterator aFirst, const InputIterator aLast,
+                                 const OutputIterator aOutput, Function &&aFunction, const size_t aGrain = 0)
+{
+    const auto count = static_cast<size_t>(aLast - aFirst);
+    ParallelChunks(aPool, count, aGrain, [&](const size_t aBegin, const size_t aEnd) {
+        std::transform(aFirst + aBegin, aFirst + aEnd, aOutput + aBegin, aFunction);
+    });
+
+    return aOutput + count;
+}
+
+// aOperation must be associative, the chunks are combined in order so it does not need to be commutative
+template <typename Iterator, typename Type, typename Operation>
+Type ParallelReduce(ThreadPool &aPool, const Iterator aFirst, const Iterator aLast, Type aInit,
+                    Operation &&aOperation, size_t aGrain = 0)
+{
+    const auto count = static_cast<size_t>(aLast - aFirst);
+    if (!aGrain)
+    {
+        aGrain = std::max<size_t>(1, count / (aPool.ThreadsCount() * 8));
+    }
+
+    const auto chunksCount = (count + aGrain - 1) / aGrain;
+    std::vector<std::optional<Type>> partials(chunksCount);
+
+    ParallelChunks(aPool, chunksCount, 1, [&](const size_t aBegin, const size_t aEnd) {
+        for (auto chunk = aBegin; chunk < aEnd; chunk++)
+        {
+            auto it = aFirst + chunk * aGrain;
+            const auto last = aFirst + std::min(count, (chunk + 1) * aGrain);
+
+            Type partial(*it++);
+            for (; it != last; it++)
+            {
+                partial = aOperation(std::move(partial), *it);
+            }
+
+            partials[chunk].emplace(std::move(partial));
+        }
+    });
+
+    for (auto &partial : partials)
+    {
+        aInit = aOperation(std::move(aInit), std::move(*partial));
+    }
+
+    return aInit;
+}
+
+// scans the chunks, prefixes their totals serially, then scans the chunks again with their offsets
+template <bool INCLUSIVE, typename InputIterator, typename OutputIterator, typename Type, typename Operation>
+OutputIterator ParallelScan(ThreadPool &aPool, const InputIterator aFirst, const InputIterator aLast,
+                            const OutputIterator aOutput, std::optional<Type> aInit, Operation &&aOperation,
+                            size_t aGrain)
+{
+    const auto count = static_cast<size_t>(aLast - aFirst);
+    if (!count)
+    {
+        return aOutput;
+    }
+
+    if (!aGrain)
+    {
+        aGrain = std::max<size_t>(1, count / (aPool.ThreadsCount() * 8));
+    }
+
+    const auto chunksCount = (count + aGrain - 1) / aGrain;
+    std::vector<std::optional<Type>> totals(chunksCount);
+
+    ParallelChunks(aPool, chunksCount, 1, [&](const size_t aBegin, const size_t aEnd) {
+        for (auto chunk = aBegin; chunk < aEnd; chunk++)
+        {
+            auto it = aFirst + chunk * aGrain;
+            const auto last = aFirst + std::min(count, (chunk + 1) * aGrain);
+
+            Type total(*it++);
+            for (; it != last; it++)
+            {
+                total = aOperation(std::move(total), *it);
+            }
+
+            totals[chunk].emplace(std::move(total));
+        }
+    });
+
+    // totals[i] becomes the prefix of everything before chunk i
+    std::optional<Type> prefix(std::move(aInit));
+    for (auto &total : totals)
+    {
+        auto next = prefix ? aOperation(*prefix, std::move(*total)) : std::move(*total);
+        total = std::move(prefix);
+        prefix.emplace(std::move(next));
+    }
+
+    ParallelChunks(aPool, chunksCount, 1, [&](const size_t aBegin, const size_t aEnd) {
+        for (auto chunk = aBegin; chunk < aEnd; chunk++)
+        {
+            const auto first = chunk * aGrain;
+            const auto last = std::min(count, (chunk + 1) * aGrain);
+
+            auto running = totals[chunk];
+            for (auto i = first; i < last; i++)
+            {
+                auto next = running ? aOperation(*running, aFirst[i]) : Type(aFirst[i]);
+                if constexpr (INCLUSIVE)
+                {
+                    aOutput[i] = next;
+                }
+                else
+                {
+                    aOutput[i] = *running;
+                }
+
+                running.emplace(std::move(next));
+            }
+        }
+    });
+
+    return aOutput + count;
+}
+
+template <typename InputIterator, typename OutputIterator, typename Operation = std::plus<>>
+OutputIterator ParallelInclusiveScan(ThreadPool &aPool, const InputIterator aFirst, const InputIterator aLast,
+                                     const OutputIterator aOutput, Operation &&aOperation = {}, const size_t aGrain = 0)
+{
+    using Type = std::iter_value_t<InputIterator>;
+    return ParallelScan<true>(aPool, aFirst, aLast, aOutput, std::optional<Type>(),
+                              std::forward<Operation>(aOperation), aGrain);
+}
+
+template <typename InputIterator, typename OutputIterator, typename Type, typename Operation = std::plus<>>
+OutputIterator ParallelExclusiveScan(ThreadPool &aPool, const InputIterator aFirst, const InputIterator aLast,
+                                     const OutputIterator aOutput, Type aInit, Operation &&aOperation = {},
+                                     const size_t aGrain = 0)
+{
+    return ParallelScan<false>(aPool, aFirst, aLast, aOutput, std::optional<Type>(std::move(aInit)),
+                               std::forward<Operation>(aOperation), aGrain);
+}
+
+// counts the heap allocations for the benchmarks
+static std::atomic_size_t gAllocations{};
+
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif // _MSC_VER
+
+// out of line, once inlined GCC pairs the malloc or the free inside with the other operator and warns of a mismatch
+NOINLINE void *operator new(const size_t aSize)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto *pointer = std::malloc(aSize ? aSize : 1))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+NOINLINE void operator delete(void *aPointer) noexcept
+{
+    std::free(aPointer);
+}
+
+NOINLINE void operator delete(void *aPointer, size_t) noexcept
+{
+    std::free(aPointer);
+}
+
+std::any Work(std::any aContext)
+{
+    std::cout << "start task no. " << std::any_cast<size_t>(aContext) << " on thread " << std::this_thread::get_id()
+              << std::endl;
+    return true;
+}
+
+void Callback(std::any aResult, std::any aContext)
+{
+    std::cout << "end task no. " << std::any_cast<size_t>(aContext) << " on thread " << std::this_thread::get_id()
+              << " with " << std::any_cast<bool>(aResult) << std::endl;
+}
+
+// throughput of many small tasks, half of them spawned by the workers themselves
+void BenchmarkScheduler(const ThreadPool::Scheduler aScheduler, const size_t aThreadsCount,
+                        const ThreadPool::Affinity aAffinity = ThreadPool::Affinity::NONE)
+{
+    constexpr size_t rootsCount = 2'000;
+    constexpr size_t childrenCount = 16;
+    constexpr size_t tasksCount = rootsCount * (childrenCount + 1);
+
+    std::atomic_size_t done{};
+    const auto callback = [&](std::any, std::any) { done.fetch_add(1, std::memory_order_relaxed); };
+
+    ThreadPool tp(true, aThreadsCount, {aScheduler, Thread::Wait::PARK, aAffinity});
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rootsCount; i++)
+    {
+        const auto work = [&](std::any) -> std::any {
+            for (size_t j = 0; j < childrenCount; j++)
+            {
+                tp.Add({[](std::any aContext) { return aContext; }, callback, j});
+            }
+
+            return {};
+        };
+
+        tp.Add({work, callback, i});
+    }
+
+    while (done.load(std::memory_order_relaxed) != tasksCount)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (aScheduler == ThreadPool::Scheduler::SHARING ? "sharing " : "stealing")
+              << (aAffinity == ThreadPool::Affinity::NONE ? "" : " pinned") << " threads " << aThreadsCount << ": "
+              << static_cast<size_t>(tasksCount / elapsed.count()) << " tasks/s" << std::endl;
+}
+
+// time from Add() until the task starts running, with the workers idle between the tasks
+void BenchmarkLatency(const Thread::Wait aWait, const std::chrono::microseconds aGap)
+{
+    constexpr size_t tasksCount = 2'000;
+
+    Histogram histogram;
+    std::atomic_size_t done{};
+
+    const auto work = [&](std::any aContext) -> std::any {
+        const auto submitted = std::any_cast<std::chrono::steady_clock::time_point>(aContext);
+        histogram.Record(std::chrono::steady_clock::now() - submitted);
+        return {};
+    };
+    const auto callback = [&](std::any, std::any) { done.fetch_add(1, std::memory_order_relaxed); };
+
+    ThreadPool tp(true, 4, {ThreadPool::Scheduler::SHARING, aWait});
+    for (size_t i = 0; i < tasksCount; i++)
+    {
+        tp.Add({work, callback, std::chrono::steady_clock::now()});
+        std::this_thread::sleep_for(aGap);
+    }
+
+    while (done.load() != tasksCount)
+    {
+        std::this_thread::yield();
+    }
+
+    std::cout << (aWait == Thread::Wait::PARK ? "park" : "spin then park") << ", " << aGap.count() << " us apart:";
+
+    for (const auto percent : {50., 90., 99.})
+    {
+        std::cout << " p" << percent << " < " << histogram.Percentile(percent).count() << " ns";
+    }
+    std::cout << std::endl;
+
+    for (size_t i = 0; i < Histogram::BUCKETS_COUNT; i++)
+    {
+        if (histogram.Bucket(i))
+        {
+            std::cout << "\t< " << (uint64_t{1} << i) << " ns: " << histogram.Bucket(i) << std::endl;
+        }
+    }
+}
+
+// heap allocations per task, from submission until the task finished
+void BenchmarkAllocations(const ThreadPool::Scheduler aScheduler)
+{
+    constexpr size_t tasksCount = 100'000;
+
+    std::atomic_size_t done{};
+    const auto wait = [&] {
+        while (done.load() != tasksCount)
+        {
+            std::this_thread::yield();
+        }
+        done = 0;
+    };
+
+    ThreadPool tp(true, 2, {aScheduler});
+    const auto name = aScheduler == ThreadPool::Scheduler::SHARING ? "sharing " : "stealing";
+
+    auto allocations = gAllocations.load();
+    for (size_t i = 0; i < tasksCount; i++)
+    {
+        tp.Add({[](std::any aContext) { return aContext; }, [&](std::any, std::any) { done++; }, i});
+    }
+    wait();
+    std::cout << name << " Add:    " << static_cast<double>(gAllocations - allocations) / tasksCount
+              << " allocations/task" << std::endl;
+
+    allocations = gAllocations.load();
+    for (size_t i = 0; i < tasksCount; i++)
+    {
+        tp.Submit([&](const size_t aIndex, const double aScale) { done += aIndex * aScale >= 0; }, i, 0.5);
+    }
+    wait();
+    std::cout << name << " Submit: " << static_cast<double>(gAllocations - allocations) / tasksCount
+              << " allocations/task" << std::endl;
+
+    // spawned by a worker, they go on its deque when stealing
+    allocations = gAllocations.load();
+    tp.Add([&] {
+        for (size_t i = 0; i < tasksCount; i++)
+        {
+            tp.Add([&done] { done++; });
+        }
+    });
+    wait();
+    std::cout << name << " Spawn:  " << static_cast<double>(gAllocations - allocations) / tasksCount
+              << " allocations/task" << std::endl;
+}
+
+// fan-out/fan-in without blocking a worker: squares in parallel, summed by a continuation
+void DemoFutures()
+{
+    ThreadPool tp(true, 4, {ThreadPool::Scheduler::STEALING});
+
+    std::vector<Future<uint64_t>> squares;
+    for (uint64_t i = 1; i <= 100; i++)
+    {
+        squares.emplace_back(tp.Submit([](const uint64_t aValue) { return aValue * aValue; }, i));
+    }
+
+    auto sum = WhenAll(std::move(squares)).Then([](const std::vector<uint64_t> &aSquares) {
+        uint64_t sum{};
+        for (const auto square : aSquares)
+        {
+            sum += square;
+        }
+
+        return sum;
+    });
+
+    std::vector<Future<void>> sleepers;
+    for (const auto delay : {20, 10})
+    {
+        sleepers.emplace_back(tp.Submit([delay] { std::this_thread::sleep_for(std::chrono::milliseconds(delay)); }));
+    }
+
+    auto first = WhenAny(std::move(sleepers));
+
+    std::cout << "sum of squares: " << sum.Get() << ", first done: " << first.Get() << std::endl;
+
+    // a pool destroyed with a task still queued breaks its promise, and then the one of the continuation
+    Future<int> orphan;
+    {
+        ThreadPool stopped;
+        orphan = stopped.Submit([] { return 1; }).Then([](const int aValue) { return aValue + 1; });
+    }
+
+    try
+    {
+        orphan.Get();
+        std::cout << "the continuation of a dropped task ran" << std::endl;
+    }
+    catch (const std::runtime_error &aError)
+    {
+        std::cout << "dropped with the pool: " << aError.what() << std::endl;
+    }
+
+    // a thread index past the pool, so not submitted
+    const ThreadPool::Options invalid{Thread::Priority::LOW, tp.ThreadsCount() + 1};
+    std::vector<Future<int>> futures;
+    futures.emplace_back(tp.Submit([] { return 1; }));
+    futures.emplace_back(tp.Submit(invalid, [] { return 2; }));
+
+    const auto report = [](const char *aName, Future<int> aFuture) {
+        try
+        {
+            aFuture.Get();
+            std::cout << aName << " of an invalid future completed" << std::endl;
+        }
+        catch (const std::runtime_error &aError)
+        {
+            std::cout << aName << " of an invalid future: " << aError.what() << std::endl;
+        }
+    };
+
+    auto unsubmitted = tp.Submit(invalid, [] { return 3; });
+    unsubmitted.Wait();
+    report(unsubmitted.IsReady() ? "Get" : "Get (not ready)", std::move(unsubmitted));
+    report("Then", tp.Submit(invalid, [] { return 3; }).Then([](const int aValue) { return aValue; }));
+    report("WhenAll", WhenAll(std::move(futures)).Then([](auto &&) { return 0; }));
+    report("WhenAny", WhenAny(std::vector<Future<int>>(1)).Then([](auto &&) { return 0; }));
+}
+
+// 1M tasks of mixed priorities queued on a single thread, then drained
+void BenchmarkPriorities()
+{
+    constexpr size_t tasksCount = 1'000'000;
+
+    size_t done{};
+    Thread thread;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < tasksCount; i++)
+    {
+        thread.Add(Job([&done] { done++; }), static_cast<Thread::Priority>(i % 3));
+    }
+    const std::chrono::duration<double, std::nano> pushed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    thread.Start();
+    while (thread.HasWork())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const std::chrono::duration<double, std::nano> drained = std::chrono::steady_clock::now() - start;
+    thread.Stop();
+
+    std::cout << "priorities: " << pushed.count() / tasksCount << " ns/push, " << drained.count() / done
+              << " ns/pop and run" << std::endl;
+}
+
+template <typename Function> double MeasureMilliseconds(Function &&aFunction)
+{
+    const auto start = std::chrono::steady_clock::now();
+    aFunction();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchmarkParallelAlgorithms()
+{
+    constexpr size_t count = 1 << 24;
+
+    ThreadPool tp(true, std::thread::hardware_concurrency(), {ThreadPool::Scheduler::STEALING});
+
+    std::vector<double> input(count);
+    std::iota(input.begin(), input.end(), 0.);
+    std::vector<double> output(count);
+
+    const auto work = [](const double aValue) { return std::sqrt(aValue) * 1.5 + 1.; };
+
+    std::cout << "transform: serial " << MeasureMilliseconds([&] {
+        std::transform(input.begin(), input.end(), output.begin(), work);
+    }) << " ms, par " << MeasureMilliseconds([&] {
+        std::transform(std::execution::par, input.begin(), input.end(), output.begin(), work);
+    }) << " ms, pool " << MeasureMilliseconds([&] {
+        ParallelTransform(tp, input.begin(), input.end(), output.begin(), work);
+    }) << " ms" << std::endl;
+
+    // each sum is kept and compared so that none of the reductions can be dropped, exact as they are integers < 2^53
+    std::array<double, 3> sums{};
+    std::cout << "reduce: serial " << MeasureMilliseconds([&] {
+        sums[0] = std::reduce(input.begin(), input.end(), 0.);
+    }) << " ms, par " << MeasureMilliseconds([&] {
+        sums[1] = std::reduce(std::execution::par, input.begin(), input.end(), 0.);
+    }) << " ms, pool " << MeasureMilliseconds([&] {
+        sums[2] = ParallelReduce(tp, input.begin(), input.end(), 0., std::plus<>());
+    }) << " ms" << (sums[0] == sums[1] && sums[0] == sums[2] ? "" : ", different sums") << std::endl;
+
+    std::cout << "inclusive scan: serial " << MeasureMilliseconds([&] {
+        std::inclusive_scan(input.begin(), input.end(), output.begin());
+    }) << " ms, par " << MeasureMilliseconds([&] {
+        std::inclusive_scan(std::execution::par, input.begin(), input.end(), output.begin());
+    }) << " ms, pool " << MeasureMilliseconds([&] {
+        ParallelInclusiveScan(tp, input.begin(), input.end(), output.begin());
+    }) << " ms" << std::endl;
+
+    std::cout << "sum " << sums[0] << std::endl;
+
+    std::cout << "for: serial " << MeasureMilliseconds([&] {
+        std::for_each(output.begin(), output.end(), [](double &aValue) { aValue = std::sqrt(aValue); });
+    }) << " ms, par " << MeasureMilliseconds([&] {
+        std::for_each(std::execution::par, output.begin(), output.end(),
+                      [](double &aValue) { aValue = std::sqrt(aValue); });
+    }) << " ms, pool " << MeasureMilliseconds([&] {
+        ParallelFor(tp, output.begin(), output.end(), [](double &aValue) { aValue = std::sqrt(aValue); });
+    }) << " ms" << std::endl;
+}
+
+// the submission cost alone, one by one versus in batches
+void BenchmarkBatch(const ThreadPool::Scheduler aScheduler, const size_t aBatchSize)
+{
+    constexpr size_t tasksCount = 1 << 16;
+
+    std::atomic_size_t done{};
+    const auto work = [](std::any aContext) { return aContext; };
+    const auto callback = [&](std::any, std::any) { done.fetch_add(1, std::memory_order_relaxed); };
+
+    ThreadPool tp(true, 4, {aScheduler});
+    std::vector<Thread::Task> tasks;
+
+    double single{}, batched{};
+    for (size_t batch = 0; batch < tasksCount / aBatchSize; batch++)
+    {
+        tasks.assign(aBatchSize, {work, callback, batch});
+        single += MeasureMilliseconds([&] {
+            for (auto &task : tasks)
+            {
+                tp.Add(std::move(task));
+            }
+        });
+
+        tasks.assign(aBatchSize, {work, callback, batch});
+        batched += MeasureMilliseconds([&] { tp.AddBatch(tasks); });
+    }
+
+    while (done.load() != tasksCount * 2)
+    {
+        std::this_thread::yield();
+    }
+
+    std::cout << (aScheduler == ThreadPool::Scheduler::SHARING ? "sharing " : "stealing") << " batch " << aBatchSize
+              << ": Add " << single * 1'000'000 / tasksCount << " ns/task, AddBatch "
+              << batched * 1'000'000 / tasksCount << " ns/task" << std::endl;
+}
+
+// per thread counters and a trace.json to open in chrome://tracing, needs THREAD_POOL_METRICS
+void DemoMetrics()
+{
+    ChromeTrace trace;
+
+    ThreadPool::Config config;
+    config.scheduler = ThreadPool::Scheduler::STEALING;
+    config.trace = trace.Hook();
+
+    {
+        ThreadPool tp(true, 4, config);
+        ParallelFor(tp, size_t{}, size_t{1'000}, [](const size_t aIndex) {
+            std::this_thread::sleep_for(std::chrono::microseconds(aIndex % 100));
+        });
+
+        for (size_t i = 0; i < tp.ThreadsCount(); i++)
+        {
+            const auto &metrics = tp.GetMetrics(i);
+            std::cout << "thread " << i << ": " << metrics.tasksExecuted << " tasks, " << metrics.steals << " steals, "
+                      << metrics.busyNanoseconds / 1'000 << " us busy, " << metrics.idleNanoseconds / 1'000
+                      << " us idle, queue depth max " << metrics.queueDepthMax << ", queue wait p99 < "
+                      << metrics.queueWait.Percentile(99).count() << " ns, run time p99 < "
+                      << metrics.runTime.Percentile(99).count() << " ns" << std::endl;
+        }
+    }
+
+    std::ofstream ofs("trace.json");
+    trace.Write(ofs);
+}
+
+// bursts of work grow the pool, the quiet periods in between shrink it back, then it drains before stopping
+void BenchmarkResizing(const ThreadPool::Scheduler aScheduler)
+{
+    ThreadPool::Config config;
+    config.scheduler = aScheduler;
+    config.threadsMin = 1;
+    config.threadsMax = 8;
+    config.backlogPerThread = 16;
+    config.idleTimeout = std::chrono::milliseconds(50);
+    config.resizePeriod = std::chrono::milliseconds(5);
+
+    ThreadPool tp(true, 1, config);
+
+    constexpr size_t burstsCount = 3;
+    constexpr size_t tasksCount = 1 << 12;
+
+    std::atomic_size_t done{};
+    for (size_t burst = 0; burst < burstsCount; burst++)
+    {
+        size_t threadsMax{};
+        const auto duration = MeasureMilliseconds([&] {
+            for (size_t i = 0; i < tasksCount; i++)
+            {
+                tp.Submit([&done] {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+                threadsMax = std::max(threadsMax, tp.ThreadsCount());
+            }
+
+            while (tp.PendingCount())
+            {
+                threadsMax = std::max(threadsMax, tp.ThreadsCount());
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        std::cout << (aScheduler == ThreadPool::Scheduler::SHARING ? "sharing " : "stealing") << " burst " << burst
+                  << ": " << tasksCount * 1'000 / duration << " tasks/s, up to " << threadsMax << " threads";
+
+        std::this_thread::sleep_for(config.idleTimeout * 4);
+        std::cout << ", " << tp.ThreadsCount() << " after idling" << std::endl;
+    }
+
+    for (size_t i = 0; i < tasksCount; i++)
+    {
+        tp.Submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    tp.StopAfterCompletion();
+
+    std::cout << "drained " << done << " of " << (burstsCount + 1) * tasksCount << " tasks" << std::endl;
+
+    // growing a pool again does not wait for its retiring threads to finish their tasks, and a fixed size pool stays at
+    // the size it is given
+    ThreadPool::Config fixedConfig;
+    fixedConfig.scheduler = aScheduler;
+    fixedConfig.resizePeriod = config.resizePeriod;
+
+    ThreadPool fixed(true, 4, fixedConfig);
+    for (size_t i = 0; i < fixed.ThreadsCount(); i++)
+    {
+        fixed.Submit([] { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+    }
+    fixed.Resize(1);
+    const auto regrowth = MeasureMilliseconds([&fixed] { fixed.Resize(4); });
+
+    // a backlog on the one thread left that would grow a resizable pool
+    fixed.Resize(1);
+    for (size_t i = 0; i < fixedConfig.backlogPerThread * 4; i++)
+    {
+        fixed.Submit([] { std::this_thread::sleep_for(std::chrono::microseconds(500)); });
+    }
+    std::this_thread::sleep_for(config.resizePeriod * 30);
+
+    std::cout << "fixed pool: grown back in " << regrowth << " ms, " << fixed.ThreadsCount()
+              << " threads after shrinking to 1" << std::endl;
+}
+
+// the WinRT Async Example, portable, the two of them run at the same time on the pool
+Async<int> Initialize(ThreadPool &aPool)
+{
+    co_await aPool.Schedule();
+
+    std::cout << "Initializing..." << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    std::cout << "Done initializing..." << std::endl;
+
+    co_return -69;
+}
+
+Async<bool> HasActiveLicense(ThreadPool &aPool)
+{
+    co_await aPool.Schedule();
+
+    std::cout << "Gathering license..." << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::cout << "Invalid license..." << std::endl;
+
+    co_return false;
+}
+
+Async<void> RunAsync(ThreadPool &aPool)
+{
+    const auto [initialized, isLicenseValid] = co_await WhenAll(Initialize(aPool), HasActiveLicense(aPool));
+
+    std::cout << (initialized == -69 ? "Initialized" : "Failed initializing...") << std::endl;
+    std::cout << (isLicenseValid ? "Valid license" : "Invalid license") << std::endl;
+}
+
+// every level completes synchronously, symmetric transfer keeps the stack flat
+Async<size_t> CountDown(const size_t aDepth)
+{
+    if (!aDepth)
+    {
+        co_return 0;
+    }
+
+    co_return 1 + co_await CountDown(aDepth - 1);
+}
+
+Async<void> Hop(ThreadPool &aPool, const size_t aHopsCount)
+{
+    for (size_t i = 0; i < aHopsCount; i++)
+    {
+        co_await aPool.Schedule();
+    }
+}
+
+// the cost of moving a coroutine to a worker versus a task posting the next one from its callback
+void BenchmarkAsync(const ThreadPool::Scheduler aScheduler)
+{
+    constexpr size_t hopsCount = 1 << 16;
+
+    // outlives the pool, the last callback may still be notifying
+    std::atomic_size_t remaining{hopsCount};
+
+    ThreadPool tp(true, 4, {aScheduler});
+
+    const auto coroutine = MeasureMilliseconds([&] { Hop(tp, hopsCount).Get(); });
+
+    std::function<void()> post = [&] {
+        tp.Add({[](std::any aContext) { return aContext; },
+                [&](std::any, std::any) {
+                    if (remaining.fetch_sub(1) != 1)
+                    {
+                        post();
+                    }
+                    else
+                    {
+                        remaining.notify_all();
+                    }
+                },
+                {}});
+    };
+
+    const auto task = MeasureMilliseconds([&] {
+        post();
+        for (auto count = remaining.load(); count; count = remaining.load())
+        {
+            remaining.wait(count);
+        }
+    });
+
+    std::cout << (aScheduler == ThreadPool::Scheduler::SHARING ? "sharing " : "stealing")
+              << " switch: co_await Schedule " << coroutine * 1'000'000 / hopsCount << " ns, Thread::Task "
+              << task * 1'000'000 / hopsCount << " ns" << std::endl;
+}
+
+// tens of thousands of pending timers on a two thread pool, half of them cancelled, and a periodic one
+void BenchmarkTimers()
+{
+    constexpr size_t timersCount = 50'000;
+    constexpr auto period = std::chrono::milliseconds(10);
+
+    Histogram lateness;
+    std::atomic_size_t fired{}, periods{};
+
+    ThreadPool tp(true, 2);
+    std::vector<TimerWheel::Timer> timers(timersCount);
+
+    const auto added = MeasureMilliseconds([&] {
+        for (size_t i = 0; i < timers.size(); i++)
+        {
+            const auto delay = std::chrono::milliseconds(1 + i * 7'919 % 500);
+            const auto due = std::chrono::steady_clock::now() + delay;
+            timers[i] = tp.AddAfter(delay, [&lateness, &fired, due] {
+                lateness.Record(std::chrono::steady_clock::now() - due);
+                fired.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    });
+
+    size_t cancelledCount{};
+    const auto cancelled = MeasureMilliseconds([&] {
+        for (size_t i = 1; i < timers.size(); i += 2)
+        {
+            cancelledCount += timers[i].Cancel();
+        }
+    });
+
+    const auto every = tp.AddEvery(period, [&periods] { periods.fetch_add(1, std::memory_order_relaxed); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    every.Cancel();
+
+    std::cout << "timers: AddAfter " << added * 1'000'000 / timersCount << " ns, Cancel "
+              << cancelled * 1'000'000 / cancelledCount << " ns, " << fired << " fired of "
+              << timersCount - cancelledCount << ", late p50 < " << lateness.Percentile(50).count() / 1'000
+              << " us, p99 < " << lateness.Percentile(99).count() / 1'000 << " us, " << periods
+              << " periods of 10 ms in 600 ms on " << tp.ThreadsCount() << " threads" << std::endl;
+}
+
+// timers due on a tick that cascades them down from the second level, they must not fire a tick late
+bool VerifyTimerCascade()
+{
+    constexpr auto tick = std::chrono::milliseconds(5);
+
+    const auto before = std::chrono::steady_clock::now();
+    TimerWheel wheel(tick);
+    wheel.Start();
+
+    bool valid = true;
+    std::vector<std::pair<uint64_t, uint64_t>> fired;
+    std::mutex mutex;
+
+    // half a tick early, rounded up to the due tick
+    for (const uint64_t due : {64, 128})
+    {
+        wheel.Add(due * tick - tick / 2, {}, [&wheel, &fired, &mutex, due] {
+            std::scoped_lock lock(mutex);
+            fired.emplace_back(due, wheel.FiringTick());
+        });
+    }
+
+    // the only time taken from the clock, it may push the due ticks later on a loaded machine but never earlier, the
+    // wheel's own count of ticks says when they fired
+    const auto added = std::chrono::steady_clock::now() - before;
+
+    std::this_thread::sleep_for(130 * tick);
+    for (size_t i = 0; wheel.Count() && i < 1'000; i++)
+    {
+        std::this_thread::sleep_for(tick);
+    }
+    wheel.Stop();
+
+    std::scoped_lock lock(mutex);
+    for (const auto &[due, at] : fired)
+    {
+        const auto dueLatest = (added + due * tick - tick / 2 + tick - std::chrono::nanoseconds(1)) / tick;
+        if (at > static_cast<uint64_t>(dueLatest))
+        {
+            std::cout << "the timer due on tick " << due << " fired on tick " << at << std::endl;
+            valid = false;
+        }
+    }
+
+    if (fired.size() != 2)
+    {
+        std::cout << fired.size() << " of 2 timers fired" << std::endl;
+        valid = false;
+    }
+
+    return valid;
+}
 
 int main()
 {
+    // reported at the end, the demos and the benchmarks run anyway
+    const auto timersValid = VerifyTimerCascade();
+
+    BenchmarkTimers();
+
+    {
+        ThreadPool tp(true, 2);
+        std::cout << MeasureMilliseconds([&] { RunAsync(tp).Get(); }) << " ms for both" << std::endl;
+        std::cout << "awaited " << CountDown(100'000).Get() << " nested coroutines" << std::endl;
+    }
+
+    for (const auto scheduler : {ThreadPool::Scheduler::SHARING, ThreadPool::Scheduler::STEALING})
+    {
+        BenchmarkAsync(scheduler);
+    }
+
+    for (const auto scheduler : {ThreadPool::Scheduler::SHARING, ThreadPool::Scheduler::STEALING})
+    {
+        BenchmarkResizing(scheduler);
+    }
+
+    if constexpr (THREAD_POOL_METRICS)
+    {
+        DemoMetrics();
+    }
+
+    for (const auto scheduler : {ThreadPool::Scheduler::SHARING, ThreadPool::Scheduler::STEALING})
+    {
+        for (const size_t batchSize : {1, 64, 4096})
+        {
+            BenchmarkBatch(scheduler, batchSize);
+        }
+    }
+
+    BenchmarkParallelAlgorithms();
+
+    BenchmarkPriorities();
+
+    DemoFutures();
+
+    BenchmarkAllocations(ThreadPool::Scheduler::SHARING);
+    BenchmarkAllocations(ThreadPool::Scheduler::STEALING);
+
+    for (const auto wait : {Thread::Wait::PARK, Thread::Wait::SPIN_THEN_PARK})
+    {
+        for (const auto gap : {std::chrono::microseconds(0), std::chrono::microseconds(50)})
+        {
+            BenchmarkLatency(wait, gap);
+        }
+    }
+
+    for (const auto scheduler : {ThreadPool::Scheduler::SHARING, ThreadPool::Scheduler::STEALING})
+    {
+        for (const size_t threadsCount : {1, 2, 4, 8, 16, 32, 64})
+        {
+            BenchmarkScheduler(scheduler, threadsCount);
+        }
+    }
+
+    // a thread per CPU, pinned, stealing within the NUMA node first
+    BenchmarkScheduler(ThreadPool::Scheduler::STEALING, std::thread::hardware_concurrency(),
+                       ThreadPool::Affinity::CPU);
+
     ThreadPool tp(true);
 
     for (size_t i = 0; i < 100; i++)
@@ -231,5 +4455,5 @@ int main()
 
     std::cin.get();
 
-    return 0;
+    return timersValid ? 0 : 1;
 }
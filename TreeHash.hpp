@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+
+// hashes fixed-size leaves in parallel with aHash(std::span<const uint8_t>) -> uint64_t and keeps their digests,
+// the root is aHash over the little-endian leaf digests followed by the total size and the leaf size, so it is NOT
+// the plain digest of the data and changes with the leaf size, a change re-hashes only the leaves it touches
+template <typename Hash> class TreeHash
+{
+  public:
+    static constexpr uint64_t LEAF_SIZE = 4 << 20;
+
+  public:
+    explicit TreeHash(Hash aHash, const uint64_t aLeafSize = LEAF_SIZE, const size_t aThreadsCount = 0)
+        : mHash(std::move(aHash)), mLeafSize(std::max<uint64_t>(aLeafSize, 1)),
+          mThreadsCount(aThreadsCount ? aThreadsCount : std::max(std::thread::hardware_concurrency(), 1u))
+    {
+    }
+
+    uint64_t Digest(const std::span<const uint8_t> aData)
+    {
+        mSize = aData.size();
+        mLeaves.resize(LeavesCount(mSize));
+
+        HashLeaves(aData, mLeaves.size(), [](const size_t aIndex) { return aIndex; }, mLeaves);
+        return DigestRoot();
+    }
+
+    // {} if the file could not be read
+    uint64_t DigestFile(const std::filesystem::path &aFile)
+    {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(aFile, error);
+        if (error)
+        {
+            return {};
+        }
+
+        std::vector<uint64_t> leaves(LeavesCount(size));
+        if (!HashFileLeaves(aFile, size, leaves))
+        {
+            return {};
+        }
+
+        mSize = size;
+        mLeaves = std::move(leaves);
+        return DigestRoot();
+    }
+
+    // aData is the whole new data where [aOffset, aOffset + aSize) changed, it may have grown or shrunk
+    uint64_t Update(const std::span<const uint8_t> aData, const uint64_t aOffset, const uint64_t aSize)
+    {
+        const auto dirty = DirtyLeaves(aData.size(), aOffset, aSize);
+
+        mSize = aData.size();
+        mLeaves.resize(LeavesCount(mSize));
+
+        HashLeaves(aData, dirty.size(), [&](const size_t aIndex) { return dirty[aIndex]; }, mLeaves);
+        return DigestRoot();
+    }
+
+    // the leaves of aData that differ from the ones digested, all of them past the shorter of the two
+    std::vector<size_t> Verify(const std::span<const uint8_t> aData) const
+    {
+        std::vector<uint64_t> leaves(LeavesCount(aData.size()));
+        HashLeaves(aData, leaves.size(), [](const size_t aIndex) { return aIndex; }, leaves);
+
+        return Mismatches(leaves);
+    }
+
+    // every leaf if the file could not be read
+    std::vector<size_t> VerifyFile(const std::filesystem::path &aFile) const
+    {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(aFile, error);
+
+        std::vector<uint64_t> leaves(error ? 0 : LeavesCount(size));
+        if (error || !HashFileLeaves(aFile, size, leaves))
+        {
+            std::vector<size_t> all(mLeaves.size());
+            std::iota(all.begin(), all.end(), size_t{});
+            return all;
+        }
+
+        return Mismatches(leaves);
+    }
+
+  public:
+    uint64_t Root() const noexcept
+    {
+        return mRoot;
+    }
+
+    std::span<const uint64_t> Leaves() const noexcept
+    {
+        return mLeaves;
+    }
+
+    uint64_t LeafSize() const noexcept
+    {
+        return mLeafSize;
+    }
+
+  private:
+    size_t LeavesCount(const uint64_t aSize) const noexcept
+    {
+        return static_cast<size_t>((aSize + mLeafSize - 1) / mLeafSize);
+    }
+
+    std::vector<size_t> DirtyLeaves(const uint64_t aSize, const uint64_t aOffset, const uint64_t aChangedSize) const
+    {
+        const auto count = LeavesCount(aSize);
+
+        auto begin = static_cast<size_t>(aOffset / mLeafSize);
+        auto end = LeavesCount(aOffset + aChangedSize);
+
+        // a new size moves the end of the last leaf both had and adds or drops the ones after
+        if (aSize != mSize)
+        {
+            begin = std::min<size_t>(begin, std::min(aSize, mSize) / mLeafSize);
+            end = count;
+        }
+        end = std::min(end, count);
+        begin = std::min(begin, end);
+
+        std::vector<size_t> dirty(end - begin);
+        std::iota(dirty.begin(), dirty.end(), begin);
+        return dirty;
+    }
+
+    std::vector<size_t> Mismatches(const std::span<const uint64_t> aLeaves) const
+    {
+        std::vector<size_t> mismatches;
+        for (size_t i = 0; i < std::max(aLeaves.size(), mLeaves.size()); i++)
+        {
+            if (i >= aLeaves.size() || i >= mLeaves.size() || aLeaves[i] != mLeaves[i])
+            {
+                mismatches.push_back(i);
+            }
+        }
+
+        return mismatches;
+    }
+
+    uint64_t DigestRoot()
+    {
+        std::vector<uint8_t> bytes;
+        bytes.reserve((mLeaves.size() + 2) * sizeof(uint64_t));
+
+        const auto append = [&](uint64_t aValue) {
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                aValue = std::byteswap(aValue);
+            }
+            const auto *value = reinterpret_cast<const uint8_t *>(&aValue);
+            bytes.insert(bytes.end(), value, value + sizeof(aValue));
+        };
+
+        for (const auto leaf : mLeaves)
+        {
+            append(leaf);
+        }
+        append(mSize);
+        append(mLeafSize);
+
+        return mRoot = mHash(std::span<const uint8_t>(bytes));
+    }
+
+    // aLeaf(i) is the index of the i-th of aCount leaves to hash into aLeaves
+    template <typename Leaf>
+    void HashLeaves(const std::span<const uint8_t> aData, const size_t aCount, Leaf &&aLeaf,
+                    std::vector<uint64_t> &aLeaves) const
+    {
+        Parallel(aCount, [&] {
+            return [&](const size_t aIndex) {
+                const auto leaf = aLeaf(aIndex);
+                const auto offset = leaf * mLeafSize;
+                aLeaves[leaf] = mHash(aData.subspan(offset, std::min<uint64_t>(mLeafSize, aData.size() - offset)));
+            };
+        });
+    }
+
+    // each thread reads its leaves through its own stream
+    bool HashFileLeaves(const std::filesystem::path &aFile, const uint64_t aSize, std::vector<uint64_t> &aLeaves) const
+    {
+        std::atomic_bool failed{};
+
+        Parallel(aLeaves.size(), [&] {
+            return [&, ifs = std::ifstream(aFile, std::ios::binary),
+                    buffer = std::vector<uint8_t>(std::min(mLeafSize, aSize))](const size_t aIndex) mutable {
+                const auto offset = aIndex * mLeafSize;
+                const auto size = std::min(mLeafSize, aSize - offset);
+
+                if (!ifs.seekg(offset) || !ifs.read(reinterpret_cast<char *>(buffer.data()), size))
+                {
+                    failed = true;
+                    return;
+                }
+                aLeaves[aIndex] = mHash(std::span<const uint8_t>(buffer.data(), size));
+            };
+        });
+
+        return !failed;
+    }
+
+    // runs the callables aWorker() makes on up to mThreadsCount threads, this one included, for indexes [0, aCount)
+    template <typename Worker> void Parallel(const size_t aCount, Worker &&aWorker) const
+    {
+        std::atomic_size_t next{};
+        const auto run = [&] {
+            auto work = aWorker();
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < aCount;)
+            {
+                work(i);
+            }
+        };
+
+        std::vector<std::jthread> threads;
+        for (size_t i = 1; i < std::min(mThreadsCount, aCount); i++)
+        {
+            threads.emplace_back(run);
+        }
+        run();
+    }
+
+  private:
+    Hash mHash;
+    uint64_t mLeafSize;
+    size_t mThreadsCount;
+
+    uint64_t mSize{};
+    uint64_t mRoot{};
+    std::vector<uint64_t> mLeaves;
+};
@@ -0,0 +1,160 @@
+#include "XXH3.hpp"
+#include "XXHash64.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+// the digests of the reference implementation over the bytes 0, 1, 2..., then streamed, on every SIMD kernel
+bool Verify()
+{
+    struct Vector
+    {
+        size_t size;
+        uint64_t seed;
+        uint64_t digest;
+        XXH3::Hash128 digest128;
+    };
+
+    constexpr Vector vectors[] = {
+        {0, 0x0000000000000000ULL, 0x2D06800538D394C2ULL, {0x6001C324468D497FULL, 0x99AA06D3014798D8ULL}},
+        {3, 0x0000000000000000ULL, 0x5F4299FC161C9CBBULL, {0x5F4299FC161C9CBBULL, 0xE3B55F57945A17CFULL}},
+        {8, 0x0000000000000000ULL, 0x3A1C2D7C85AF88F8ULL, {0xCFD50C61C8BB98C1ULL, 0xE1E4432A62217FE4ULL}},
+        {16, 0x0000000000000000ULL, 0x8355E3A6F61770DBULL, {0x842812CC870DCAE2ULL, 0x72950631827607E2ULL}},
+        {100, 0x0000000000000000ULL, 0x004E4F921A64BD1CULL, {0x29B20BA5F03EC01EULL, 0xDA95EF16FD9566F3ULL}},
+        {200, 0x0000000000000000ULL, 0xF42A8864FEAF0703ULL, {0xDD97E9AF3609D9F5ULL, 0xCB0395310643BA0EULL}},
+        {1000, 0x0000000000000000ULL, 0xD33DD80B46F60E50ULL, {0xD33DD80B46F60E50ULL, 0x076F7E02B7120D2AULL}},
+        {5000, 0x0000000000000000ULL, 0x1B74BDA2C82A8C7AULL, {0x1B74BDA2C82A8C7AULL, 0x7A681524919C2822ULL}},
+        {0, 0x9E3779B185EBCA8DULL, 0xA8A6B918B2F0364AULL, {0xA986DFC5D7605BFEULL, 0x00FEAA732A3CE25EULL}},
+        {3, 0x9E3779B185EBCA8DULL, 0x1A6E223BE5F46239ULL, {0x1A6E223BE5F46239ULL, 0x05A6AA16B11FAD25ULL}},
+        {8, 0x9E3779B185EBCA8DULL, 0xCE514ADFB5603640ULL, {0x9AB168E5C7E5CCA6ULL, 0xAC54DB92D3B6A1F5ULL}},
+        {16, 0x9E3779B185EBCA8DULL, 0x39B05B5E53840A8FULL, {0x1404CA89C1EF2171ULL, 0x1B5F34DBED11A4ACULL}},
+        {100, 0x9E3779B185EBCA8DULL, 0xBB8BD1373296C821ULL, {0x268853AE2C94FE91ULL, 0x6A46E5B37D79AD05ULL}},
+        {200, 0x9E3779B185EBCA8DULL, 0x691576F7592C8D3EULL, {0xE595D4DA88F3E78DULL, 0x24152DEFFACA882AULL}},
+        {1000, 0x9E3779B185EBCA8DULL, 0xDEEC8C7BDE4CFF14ULL, {0xDEEC8C7BDE4CFF14ULL, 0xA247365D5356B488ULL}},
+        {5000, 0x9E3779B185EBCA8DULL, 0x3DB61AC1EF0F06CDULL, {0x3DB61AC1EF0F06CDULL, 0x256BF0690219D6CAULL}},
+    };
+
+    std::vector<uint8_t> data(5'000);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    const auto simd = XXH3::GetSimd();
+    for (const auto kernel : {XXH3::Simd::SCALAR, XXH3::Simd::AVX2, XXH3::Simd::AVX512})
+    {
+        if (!XXH3::SetSimd(kernel))
+        {
+            continue;
+        }
+
+        for (const auto &vector : vectors)
+        {
+            const std::span<const uint8_t> input(data.data(), vector.size);
+
+            XXH3 hasher(vector.seed);
+            for (size_t offset = 0, piece = 1; offset < input.size(); offset += piece, piece = piece * 7 % 300 + 1)
+            {
+                hasher.Update(input.subspan(offset, std::min(piece, input.size() - offset)));
+            }
+
+            if (XXH3::DigestData(input, vector.seed) != vector.digest ||
+                XXH3::DigestData128(input, vector.seed) != vector.digest128 || hasher.Digest() != vector.digest ||
+                hasher.Digest128() != vector.digest128)
+            {
+                std::cout << "wrong digest of " << vector.size << " B, seed " << vector.seed << ", kernel "
+                          << static_cast<int>(kernel) << std::endl;
+                return false;
+            }
+        }
+    }
+    XXH3::SetSimd(simd);
+
+    return true;
+}
+
+template <typename Function> double MeasureNanoseconds(const size_t aCount, Function &&aFunction)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < aCount; i++)
+    {
+        aFunction(i);
+    }
+    const std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - start;
+
+    return duration.count() / aCount;
+}
+
+// the hash table case, every digest depends on the previous one so this is the latency and not the throughput
+void BenchmarkShortKeys()
+{
+    constexpr size_t count = 10'000'000;
+
+    std::vector<uint8_t> data(128);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    for (const size_t size : {8, 16, 24, 32, 48, 64})
+    {
+        uint64_t digest{};
+        const auto xxh64 = MeasureNanoseconds(count, [&](size_t) {
+            digest = XXHash64::DigestData({data.data() + digest % 16, size});
+        });
+        const auto xxh3 = MeasureNanoseconds(count, [&](size_t) {
+            digest = XXH3::DigestData({data.data() + digest % 16, size});
+        });
+        const auto xxh128 = MeasureNanoseconds(count, [&](size_t) {
+            digest = XXH3::DigestData128({data.data() + digest % 16, size}).low;
+        });
+
+        // printed so that the chain of digests is not optimized away
+        std::cout << size << " B: XXHash64 " << xxh64 << " ns, XXH3 " << xxh3 << " ns, XXH3 128 " << xxh128
+                  << " ns (" << digest % 10 << ")" << std::endl;
+    }
+}
+
+void BenchmarkThroughput()
+{
+    constexpr size_t size = 1 << 20;
+    constexpr size_t count = 1 << 10;
+
+    std::vector<uint8_t> data(size + 16);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    uint64_t digest{};
+    const auto xxh64 = MeasureNanoseconds(count, [&](size_t) {
+        digest = XXHash64::DigestData({data.data() + digest % 16, size});
+    });
+    std::cout << "1 MiB: XXHash64 " << size / xxh64 << " GB/s";
+
+    const auto simd = XXH3::GetSimd();
+    for (const auto kernel : {XXH3::Simd::SCALAR, XXH3::Simd::AVX2, XXH3::Simd::AVX512})
+    {
+        if (!XXH3::SetSimd(kernel))
+        {
+            continue;
+        }
+
+        const auto xxh3 = MeasureNanoseconds(count, [&](size_t) {
+            digest = XXH3::DigestData({data.data() + digest % 16, size});
+        });
+        std::cout << ", XXH3 "
+                  << (kernel == XXH3::Simd::SCALAR ? "scalar " : kernel == XXH3::Simd::AVX2 ? "AVX2 " : "AVX-512 ")
+                  << size / xxh3 << " GB/s";
+    }
+    XXH3::SetSimd(simd);
+
+    std::cout << " (" << digest % 10 << ")" << std::endl;
+}
+
+int main()
+{
+    if (!Verify())
+    {
+        return 1;
+    }
+
+    BenchmarkShortKeys();
+    BenchmarkThroughput();
+
+    return 0;
+}
@@ -0,0 +1,797 @@
+#pragma once
+
+#include "FileReader.hpp"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define XXH3_X86_SIMD 1
+#else
+#define XXH3_X86_SIMD 0
+#endif
+
+// XXH3 64 and 128 bits, bit exact with the reference xxHash 0.8, the long inputs use AVX2 or AVX-512 when available
+class XXH3
+{
+  public:
+    struct Hash128
+    {
+        uint64_t low{};
+        uint64_t high{};
+
+        bool operator==(const Hash128 &) const = default;
+    };
+
+    enum class Simd : uint8_t
+    {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    static constexpr size_t SECRET_SIZE_MIN = 136;
+
+    static uint64_t DigestData(const std::span<const uint8_t> aData, const uint64_t aSeed = {}) noexcept
+    {
+        if (aSeed && aData.size() > MIDSIZE_MAX)
+        {
+            std::array<uint8_t, SECRET_SIZE_DEFAULT> secret;
+            DeriveSecret(secret, aSeed);
+            return Hash64(aData.data(), aData.size(), secret, 0);
+        }
+
+        return Hash64(aData.data(), aData.size(), DEFAULT_SECRET, aSeed);
+    }
+
+    // aSecret must be at least SECRET_SIZE_MIN bytes of high entropy
+    static uint64_t DigestData(const std::span<const uint8_t> aData, const std::span<const uint8_t> aSecret) noexcept
+    {
+        assert(aSecret.size() >= SECRET_SIZE_MIN);
+        return Hash64(aData.data(), aData.size(), aSecret, 0);
+    }
+
+    static uint64_t DigestString(const std::string_view aString, const uint64_t aSeed = {}) noexcept
+    {
+        return DigestData({std::bit_cast<const uint8_t *>(aString.data()), aString.size()}, aSeed);
+    }
+
+    static uint64_t DigestFile(const std::filesystem::path &aFile, const uint64_t aChunkSize = FileReader::CHUNK_SIZE,
+                               const FileReader::Mode aMode = FileReader::Mode::MAP) noexcept
+    {
+        XXH3 hasher;
+        return UpdateFile(hasher, aFile, aChunkSize, aMode) ? hasher.Digest() : uint64_t{};
+    }
+
+    static Hash128 DigestData128(const std::span<const uint8_t> aData, const uint64_t aSeed = {}) noexcept
+    {
+        if (aSeed && aData.size() > MIDSIZE_MAX)
+        {
+            std::array<uint8_t, SECRET_SIZE_DEFAULT> secret;
+            DeriveSecret(secret, aSeed);
+            return Hash128Of(aData.data(), aData.size(), secret, 0);
+        }
+
+        return Hash128Of(aData.data(), aData.size(), DEFAULT_SECRET, aSeed);
+    }
+
+    static Hash128 DigestData128(const std::span<const uint8_t> aData, const std::span<const uint8_t> aSecret) noexcept
+    {
+        assert(aSecret.size() >= SECRET_SIZE_MIN);
+        return Hash128Of(aData.data(), aData.size(), aSecret, 0);
+    }
+
+    static Hash128 DigestString128(const std::string_view aString, const uint64_t aSeed = {}) noexcept
+    {
+        return DigestData128({std::bit_cast<const uint8_t *>(aString.data()), aString.size()}, aSeed);
+    }
+
+    static Hash128 DigestFile128(const std::filesystem::path &aFile, const uint64_t aChunkSize = FileReader::CHUNK_SIZE,
+                                 const FileReader::Mode aMode = FileReader::Mode::MAP) noexcept
+    {
+        XXH3 hasher;
+        return UpdateFile(hasher, aFile, aChunkSize, aMode) ? hasher.Digest128() : Hash128();
+    }
+
+    // the kernel of the long inputs, the best one supported is picked at startup, for tests and benchmarks
+    static Simd GetSimd() noexcept
+    {
+        return sSimd;
+    }
+
+    static bool SetSimd(const Simd aSimd) noexcept
+    {
+        if (aSimd > DetectSimd())
+        {
+            return false;
+        }
+
+        sSimd = aSimd;
+        return true;
+    }
+
+  public:
+    explicit XXH3(const uint64_t aSeed = {}) noexcept : mSeed(aSeed)
+    {
+        DeriveSecret(mSecretOwn, aSeed);
+        Reset();
+    }
+
+    // aSecret is not copied, it must outlive the hasher
+    explicit XXH3(const std::span<const uint8_t> aSecret) noexcept : mSecretExternal(aSecret)
+    {
+        assert(aSecret.size() >= SECRET_SIZE_MIN);
+        Reset();
+    }
+
+    bool Update(const std::span<const uint8_t> aData) noexcept
+    {
+        if (aData.empty())
+        {
+            return false;
+        }
+
+        mTotalSize += aData.size();
+
+        // if the data is small enough, fill the buffer with it, even completely, the last stripe is special
+        if (aData.size() <= mBuffer.size() - mBufferOffset)
+        {
+            std::memcpy(mBuffer.data() + mBufferOffset, aData.data(), aData.size());
+            mBufferOffset += aData.size();
+            return true;
+        }
+
+        const auto *data = aData.data();
+        const auto *end = data + aData.size();
+
+        // if the buffer has some data, fill it and process its stripes, there is more data after them
+        if (mBufferOffset > 0)
+        {
+            const auto size = mBuffer.size() - mBufferOffset;
+            std::memcpy(mBuffer.data() + mBufferOffset, data, size);
+            data += size;
+
+            ConsumeStripes(mAccumulators, mStripesCount, mBuffer.data(), BUFFER_STRIPES);
+            mBufferOffset = 0;
+        }
+
+        // the stripes straight from the data, all but the last byte, then the last stripe is kept for the digest
+        if (const auto stripes = static_cast<size_t>(end - data - 1) / STRIPE_SIZE)
+        {
+            ConsumeStripes(mAccumulators, mStripesCount, data, stripes);
+            data += stripes * STRIPE_SIZE;
+
+            std::memcpy(mBuffer.data() + mBuffer.size() - STRIPE_SIZE, data - STRIPE_SIZE, STRIPE_SIZE);
+        }
+
+        // fill the buffer with the remaining data
+        mBufferOffset = static_cast<size_t>(end - data);
+        std::memcpy(mBuffer.data(), data, mBufferOffset);
+
+        return true;
+    }
+
+    uint64_t Digest() const noexcept
+    {
+        if (mTotalSize > MIDSIZE_MAX)
+        {
+            auto accumulators = mAccumulators;
+            DigestLong(accumulators);
+
+            const auto secret = Secret();
+            return MergeAccumulators(accumulators, secret.data() + SECRET_MERGE_START, mTotalSize * PRIME64_1);
+        }
+
+        // everything is still in the buffer
+        if (mSeed)
+        {
+            return Hash64(mBuffer.data(), mTotalSize, DEFAULT_SECRET, mSeed);
+        }
+
+        return Hash64(mBuffer.data(), mTotalSize, Secret(), 0);
+    }
+
+    Hash128 Digest128() const noexcept
+    {
+        if (mTotalSize > MIDSIZE_MAX)
+        {
+            auto accumulators = mAccumulators;
+            DigestLong(accumulators);
+
+            const auto secret = Secret();
+            return {MergeAccumulators(accumulators, secret.data() + SECRET_MERGE_START, mTotalSize * PRIME64_1),
+                    MergeAccumulators(accumulators,
+                                      secret.data() + secret.size() - STRIPE_SIZE - SECRET_MERGE_START,
+                                      ~(mTotalSize * PRIME64_2))};
+        }
+
+        if (mSeed)
+        {
+            return Hash128Of(mBuffer.data(), mTotalSize, DEFAULT_SECRET, mSeed);
+        }
+
+        return Hash128Of(mBuffer.data(), mTotalSize, Secret(), 0);
+    }
+
+  private:
+    using Accumulators = std::array<uint64_t, 8>;
+
+    static constexpr uint32_t PRIME32_1 = 0x9E3779B1U;
+    static constexpr uint32_t PRIME32_2 = 0x85EBCA77U;
+    static constexpr uint32_t PRIME32_3 = 0xC2B2AE3DU;
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+    static constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+    static constexpr size_t SECRET_SIZE_DEFAULT = 192;
+    static constexpr size_t STRIPE_SIZE = 64;
+    static constexpr size_t SECRET_CONSUME_RATE = 8; // the secret moves by this much for each stripe
+    static constexpr size_t SECRET_LAST_STRIPE_START = 7;
+    static constexpr size_t SECRET_MERGE_START = 11;
+    static constexpr size_t MIDSIZE_MAX = 240;
+    static constexpr size_t MIDSIZE_START = 3;
+    static constexpr size_t MIDSIZE_LAST = 17;
+    static constexpr size_t BUFFER_STRIPES = 4;
+
+    static constexpr Accumulators ACCUMULATORS_INITIAL = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                                                          PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+
+    alignas(64) static constexpr std::array<uint8_t, SECRET_SIZE_DEFAULT> DEFAULT_SECRET = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    static Simd DetectSimd() noexcept
+    {
+#if XXH3_X86_SIMD
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return Simd::AVX512;
+        }
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Simd::AVX2;
+        }
+#endif // XXH3_X86_SIMD
+
+        return Simd::SCALAR;
+    }
+
+    static inline Simd sSimd = DetectSimd();
+
+    Accumulators mAccumulators{};
+    alignas(64) std::array<uint8_t, SECRET_SIZE_DEFAULT> mSecretOwn{};
+    std::span<const uint8_t> mSecretExternal{};
+    alignas(64) std::array<uint8_t, BUFFER_STRIPES * STRIPE_SIZE> mBuffer{};
+
+    uint64_t mSeed{};
+    size_t mBufferOffset{};
+    size_t mStripesCount{}; // in the current block
+    uint64_t mTotalSize{};
+
+    void Reset() noexcept
+    {
+        mAccumulators = ACCUMULATORS_INITIAL;
+    }
+
+    std::span<const uint8_t> Secret() const noexcept
+    {
+        return mSecretExternal.empty() ? std::span<const uint8_t>(mSecretOwn) : mSecretExternal;
+    }
+
+    // the default secret shifted by the seed, for the long inputs
+    static void DeriveSecret(const std::span<uint8_t, SECRET_SIZE_DEFAULT> aSecret, const uint64_t aSeed) noexcept
+    {
+        for (size_t i = 0; i < SECRET_SIZE_DEFAULT; i += 2 * sizeof(uint64_t))
+        {
+            Write64(aSecret.data() + i, Read64(DEFAULT_SECRET.data() + i) + aSeed);
+            const auto j = i + sizeof(uint64_t);
+            Write64(aSecret.data() + j, Read64(DEFAULT_SECRET.data() + j) - aSeed);
+        }
+    }
+
+    static bool UpdateFile(XXH3 &aHasher, const std::filesystem::path &aFile, const uint64_t aChunkSize,
+                           const FileReader::Mode aMode) noexcept
+    {
+        const auto update = [&](const std::span<const uint8_t> aData) { aHasher.Update(aData); };
+        return FileReader::Read(aFile, update, aMode, aChunkSize);
+    }
+
+    static uint32_t Read32(const uint8_t *aData) noexcept
+    {
+        uint32_t value;
+        std::memcpy(&value, aData, sizeof(value));
+        return value;
+    }
+
+    static uint64_t Read64(const uint8_t *aData) noexcept
+    {
+        uint64_t value;
+        std::memcpy(&value, aData, sizeof(value));
+        return value;
+    }
+
+    static void Write64(uint8_t *aData, const uint64_t aValue) noexcept
+    {
+        std::memcpy(aData, &aValue, sizeof(aValue));
+    }
+
+    static Hash128 Multiply(const uint64_t aLeft, const uint64_t aRight) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+        const auto product = static_cast<unsigned __int128>(aLeft) * aRight;
+        return {static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64)};
+#else
+        const auto lowLow = (aLeft & 0xFFFFFFFF) * (aRight & 0xFFFFFFFF);
+        const auto highLow = (aLeft >> 32) * (aRight & 0xFFFFFFFF);
+        const auto lowHigh = (aLeft & 0xFFFFFFFF) * (aRight >> 32);
+        const auto highHigh = (aLeft >> 32) * (aRight >> 32);
+
+        const auto cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+        return {(cross << 32) | (lowLow & 0xFFFFFFFF), (highLow >> 32) + (cross >> 32) + highHigh};
+#endif
+    }
+
+    static uint64_t MultiplyFold(const uint64_t aLeft, const uint64_t aRight) noexcept
+    {
+        const auto product = Multiply(aLeft, aRight);
+        return product.low ^ product.high;
+    }
+
+    static constexpr uint64_t Avalanche(uint64_t aHash) noexcept
+    {
+        aHash ^= aHash >> 37;
+        aHash *= PRIME_MX1;
+        return aHash ^ (aHash >> 32);
+    }
+
+    // the final mix of XXH64
+    static constexpr uint64_t Avalanche64(uint64_t aHash) noexcept
+    {
+        aHash ^= aHash >> 33;
+        aHash *= PRIME64_2;
+        aHash ^= aHash >> 29;
+        aHash *= PRIME64_3;
+        return aHash ^ (aHash >> 32);
+    }
+
+    static constexpr uint64_t RotateMix(uint64_t aHash, const uint64_t aSize) noexcept
+    {
+        aHash ^= std::rotl(aHash, 49) ^ std::rotl(aHash, 24);
+        aHash *= PRIME_MX2;
+        aHash ^= (aHash >> 35) + aSize;
+        aHash *= PRIME_MX2;
+        return aHash ^ (aHash >> 28);
+    }
+
+    static uint64_t Mix16(const uint8_t *aData, const uint8_t *aSecret, const uint64_t aSeed) noexcept
+    {
+        return MultiplyFold(Read64(aData) ^ (Read64(aSecret) + aSeed),
+                            Read64(aData + sizeof(uint64_t)) ^ (Read64(aSecret + sizeof(uint64_t)) - aSeed));
+    }
+
+    static void Mix32(Hash128 &aHash, const uint8_t *aFirst, const uint8_t *aSecond, const uint8_t *aSecret,
+                      const uint64_t aSeed) noexcept
+    {
+        aHash.low += Mix16(aFirst, aSecret, aSeed);
+        aHash.low ^= Read64(aSecond) + Read64(aSecond + sizeof(uint64_t));
+        aHash.high += Mix16(aSecond, aSecret + 16, aSeed);
+        aHash.high ^= Read64(aFirst) + Read64(aFirst + sizeof(uint64_t));
+    }
+
+    static uint64_t Hash64(const uint8_t *aData, const size_t aSize, const std::span<const uint8_t> aSecret,
+                           const uint64_t aSeed) noexcept
+    {
+        const auto *secret = aSecret.data();
+
+        if (aSize > MIDSIZE_MAX)
+        {
+            auto accumulators = ACCUMULATORS_INITIAL;
+            HashLong(accumulators, aData, aSize, aSecret);
+            return MergeAccumulators(accumulators, secret + SECRET_MERGE_START, aSize * PRIME64_1);
+        }
+
+        if (aSize > 128)
+        {
+            uint64_t hash = aSize * PRIME64_1;
+            for (size_t i = 0; i < 8; i++)
+            {
+                hash += Mix16(aData + 16 * i, secret + 16 * i, aSeed);
+            }
+            hash = Avalanche(hash);
+
+            for (size_t i = 8; i < aSize / 16; i++)
+            {
+                hash += Mix16(aData + 16 * i, secret + 16 * (i - 8) + MIDSIZE_START, aSeed);
+            }
+            hash += Mix16(aData + aSize - 16, secret + SECRET_SIZE_MIN - MIDSIZE_LAST, aSeed);
+
+            return Avalanche(hash);
+        }
+
+        if (aSize > 16)
+        {
+            // pairs from both ends towards the middle
+            uint64_t hash = aSize * PRIME64_1;
+            for (size_t i = 0; i < (aSize - 1) / 32 + 1; i++)
+            {
+                hash += Mix16(aData + 16 * i, secret + 32 * i, aSeed);
+                hash += Mix16(aData + aSize - 16 * (i + 1), secret + 32 * i + 16, aSeed);
+            }
+
+            return Avalanche(hash);
+        }
+
+        if (aSize > 8)
+        {
+            const auto low = Read64(aData) ^ ((Read64(secret + 24) ^ Read64(secret + 32)) + aSeed);
+            const auto high = Read64(aData + aSize - 8) ^ ((Read64(secret + 40) ^ Read64(secret + 48)) - aSeed);
+            return Avalanche(aSize + std::byteswap(low) + high + MultiplyFold(low, high));
+        }
+
+        if (aSize >= 4)
+        {
+            const auto seed = aSeed ^ (static_cast<uint64_t>(std::byteswap(static_cast<uint32_t>(aSeed))) << 32);
+            const auto value = Read32(aData + aSize - 4) + (static_cast<uint64_t>(Read32(aData)) << 32);
+            return RotateMix(value ^ ((Read64(secret + 8) ^ Read64(secret + 16)) - seed), aSize);
+        }
+
+        if (aSize)
+        {
+            const uint32_t combined = (static_cast<uint32_t>(aData[0]) << 16) |
+                                      (static_cast<uint32_t>(aData[aSize >> 1]) << 24) | aData[aSize - 1] |
+                                      static_cast<uint32_t>(aSize << 8);
+            return Avalanche64(combined ^ ((Read32(secret) ^ Read32(secret + 4)) + aSeed));
+        }
+
+        return Avalanche64(aSeed ^ Read64(secret + 56) ^ Read64(secret + 64));
+    }
+
+    static Hash128 Hash128Of(const uint8_t *aData, const size_t aSize, const std::span<const uint8_t> aSecret,
+                             const uint64_t aSeed) noexcept
+    {
+        const auto *secret = aSecret.data();
+
+        if (aSize > MIDSIZE_MAX)
+        {
+            auto accumulators = ACCUMULATORS_INITIAL;
+            HashLong(accumulators, aData, aSize, aSecret);
+            return {MergeAccumulators(accumulators, secret + SECRET_MERGE_START, aSize * PRIME64_1),
+                    MergeAccumulators(accumulators, secret + aSecret.size() - STRIPE_SIZE - SECRET_MERGE_START,
+                                      ~(aSize * PRIME64_2))};
+        }
+
+        if (aSize > 16)
+        {
+            Hash128 hash{aSize * PRIME64_1, 0};
+            if (aSize > 128)
+            {
+                for (size_t i = 0; i < 4; i++)
+                {
+                    Mix32(hash, aData + 32 * i, aData + 32 * i + 16, secret + 32 * i, aSeed);
+                }
+                hash = {Avalanche(hash.low), Avalanche(hash.high)};
+
+                for (size_t i = 4; i < aSize / 32; i++)
+                {
+                    Mix32(hash, aData + 32 * i, aData + 32 * i + 16, secret + MIDSIZE_START + 32 * (i - 4), aSeed);
+                }
+                Mix32(hash, aData + aSize - 16, aData + aSize - 32, secret + SECRET_SIZE_MIN - MIDSIZE_LAST - 16,
+                      0 - aSeed);
+            }
+            else
+            {
+                for (size_t i = (aSize - 1) / 32 + 1; i-- > 0;)
+                {
+                    Mix32(hash, aData + 16 * i, aData + aSize - 16 * (i + 1), secret + 32 * i, aSeed);
+                }
+            }
+
+            return {Avalanche(hash.low + hash.high),
+                    0 - Avalanche(hash.low * PRIME64_1 + hash.high * PRIME64_4 + (aSize - aSeed) * PRIME64_2)};
+        }
+
+        if (aSize > 8)
+        {
+            const auto low = Read64(aData);
+            auto high = Read64(aData + aSize - 8);
+
+            auto hash = Multiply(low ^ high ^ ((Read64(secret + 32) ^ Read64(secret + 40)) - aSeed), PRIME64_1);
+            hash.low += static_cast<uint64_t>(aSize - 1) << 54;
+            high ^= (Read64(secret + 48) ^ Read64(secret + 56)) + aSeed;
+            hash.high += high + static_cast<uint64_t>(static_cast<uint32_t>(high)) * (PRIME32_2 - 1);
+            hash.low ^= std::byteswap(hash.high);
+
+            auto result = Multiply(hash.low, PRIME64_2);
+            result.high += hash.high * PRIME64_2;
+            return {Avalanche(result.low), Avalanche(result.high)};
+        }
+
+        if (aSize >= 4)
+        {
+            const auto seed = aSeed ^ (static_cast<uint64_t>(std::byteswap(static_cast<uint32_t>(aSeed))) << 32);
+            const auto value = Read32(aData) + (static_cast<uint64_t>(Read32(aData + aSize - 4)) << 32);
+
+            const auto key = (Read64(secret + 16) ^ Read64(secret + 24)) + seed;
+            auto hash = Multiply(value ^ key, PRIME64_1 + (aSize << 2));
+            hash.high += hash.low << 1;
+            hash.low ^= hash.high >> 3;
+            hash.low ^= hash.low >> 35;
+            hash.low *= PRIME_MX2;
+            hash.low ^= hash.low >> 28;
+            return {hash.low, Avalanche(hash.high)};
+        }
+
+        if (aSize)
+        {
+            const uint32_t combinedLow = (static_cast<uint32_t>(aData[0]) << 16) |
+                                         (static_cast<uint32_t>(aData[aSize >> 1]) << 24) | aData[aSize - 1] |
+                                         static_cast<uint32_t>(aSize << 8);
+            const uint32_t combinedHigh = std::rotl(std::byteswap(combinedLow), 13);
+            return {Avalanche64(combinedLow ^ ((Read32(secret) ^ Read32(secret + 4)) + aSeed)),
+                    Avalanche64(combinedHigh ^ ((Read32(secret + 8) ^ Read32(secret + 12)) - aSeed))};
+        }
+
+        return {Avalanche64(aSeed ^ Read64(secret + 64) ^ Read64(secret + 72)),
+                Avalanche64(aSeed ^ Read64(secret + 80) ^ Read64(secret + 88))};
+    }
+
+    // blocks of stripes, each block scrambles the accumulators once, the very last stripe always ends the data
+    static void HashLong(Accumulators &aAccumulators, const uint8_t *aData, const size_t aSize,
+                         const std::span<const uint8_t> aSecret) noexcept
+    {
+        const auto stripesPerBlock = (aSecret.size() - STRIPE_SIZE) / SECRET_CONSUME_RATE;
+        const auto blockSize = STRIPE_SIZE * stripesPerBlock;
+        const auto blocksCount = (aSize - 1) / blockSize;
+
+        for (size_t i = 0; i < blocksCount; i++)
+        {
+            Accumulate(aAccumulators, aData + i * blockSize, aSecret.data(), stripesPerBlock);
+            Scramble(aAccumulators, aSecret.data() + aSecret.size() - STRIPE_SIZE);
+        }
+
+        const auto stripesCount = (aSize - 1 - blockSize * blocksCount) / STRIPE_SIZE;
+        Accumulate(aAccumulators, aData + blocksCount * blockSize, aSecret.data(), stripesCount);
+        Accumulate(aAccumulators, aData + aSize - STRIPE_SIZE,
+                   aSecret.data() + aSecret.size() - STRIPE_SIZE - SECRET_LAST_STRIPE_START, 1);
+    }
+
+    // the streaming version of the blocks, aStripesCount is the position in the current block
+    void ConsumeStripes(Accumulators &aAccumulators, size_t &aStripesCount, const uint8_t *aData,
+                        size_t aStripes) const noexcept
+    {
+        const auto secret = Secret();
+        const auto stripesPerBlock = (secret.size() - STRIPE_SIZE) / SECRET_CONSUME_RATE;
+
+        while (aStripes)
+        {
+            const auto stripes = std::min(aStripes, stripesPerBlock - aStripesCount);
+            Accumulate(aAccumulators, aData, secret.data() + aStripesCount * SECRET_CONSUME_RATE, stripes);
+            aData += stripes * STRIPE_SIZE;
+            aStripes -= stripes;
+
+            aStripesCount += stripes;
+            if (aStripesCount == stripesPerBlock)
+            {
+                Scramble(aAccumulators, secret.data() + secret.size() - STRIPE_SIZE);
+                aStripesCount = 0;
+            }
+        }
+    }
+
+    // the stripes left in the buffer and the last one, which may overlap the ones already processed
+    void DigestLong(Accumulators &aAccumulators) const noexcept
+    {
+        const auto secret = Secret();
+        const auto *lastSecret = secret.data() + secret.size() - STRIPE_SIZE - SECRET_LAST_STRIPE_START;
+
+        if (mBufferOffset >= STRIPE_SIZE)
+        {
+            auto stripesCount = mStripesCount;
+            ConsumeStripes(aAccumulators, stripesCount, mBuffer.data(), (mBufferOffset - 1) / STRIPE_SIZE);
+            Accumulate(aAccumulators, mBuffer.data() + mBufferOffset - STRIPE_SIZE, lastSecret, 1);
+            return;
+        }
+
+        // the end of the previous stripe is still at the end of the buffer
+        std::array<uint8_t, STRIPE_SIZE> stripe;
+        const auto previous = STRIPE_SIZE - mBufferOffset;
+        std::memcpy(stripe.data(), mBuffer.data() + mBuffer.size() - previous, previous);
+        std::memcpy(stripe.data() + previous, mBuffer.data(), mBufferOffset);
+        Accumulate(aAccumulators, stripe.data(), lastSecret, 1);
+    }
+
+    static uint64_t MergeAccumulators(const Accumulators &aAccumulators, const uint8_t *aSecret,
+                                      uint64_t aHash) noexcept
+    {
+        for (size_t i = 0; i < aAccumulators.size(); i += 2)
+        {
+            aHash += MultiplyFold(aAccumulators[i] ^ Read64(aSecret + 8 * i),
+                                  aAccumulators[i + 1] ^ Read64(aSecret + 8 * i + 8));
+        }
+
+        return Avalanche(aHash);
+    }
+
+    static void Accumulate(Accumulators &aAccumulators, const uint8_t *aData, const uint8_t *aSecret,
+                           const size_t aStripes) noexcept
+    {
+#if XXH3_X86_SIMD
+        switch (sSimd)
+        {
+        case Simd::AVX512:
+            return AccumulateAvx512(aAccumulators.data(), aData, aSecret, aStripes);
+
+        case Simd::AVX2:
+            return AccumulateAvx2(aAccumulators.data(), aData, aSecret, aStripes);
+
+        default:
+            break;
+        }
+#endif // XXH3_X86_SIMD
+
+        AccumulateScalar(aAccumulators.data(), aData, aSecret, aStripes);
+    }
+
+    static void Scramble(Accumulators &aAccumulators, const uint8_t *aSecret) noexcept
+    {
+#if XXH3_X86_SIMD
+        switch (sSimd)
+        {
+        case Simd::AVX512:
+            return ScrambleAvx512(aAccumulators.data(), aSecret);
+
+        case Simd::AVX2:
+            return ScrambleAvx2(aAccumulators.data(), aSecret);
+
+        default:
+            break;
+        }
+#endif // XXH3_X86_SIMD
+
+        ScrambleScalar(aAccumulators.data(), aSecret);
+    }
+
+    // each lane adds its neighbour's input and the product of the halves of its keyed input
+    static void AccumulateScalar(uint64_t *aAccumulators, const uint8_t *aData, const uint8_t *aSecret,
+                                 const size_t aStripes) noexcept
+    {
+        for (size_t stripe = 0; stripe < aStripes; stripe++)
+        {
+            const auto *data = aData + stripe * STRIPE_SIZE;
+            const auto *secret = aSecret + stripe * SECRET_CONSUME_RATE;
+
+            for (size_t i = 0; i < 8; i++)
+            {
+                const auto value = Read64(data + 8 * i);
+                const auto key = value ^ Read64(secret + 8 * i);
+                aAccumulators[i ^ 1] += value;
+                aAccumulators[i] += (key & 0xFFFFFFFF) * (key >> 32);
+            }
+        }
+    }
+
+    static void ScrambleScalar(uint64_t *aAccumulators, const uint8_t *aSecret) noexcept
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            auto accumulator = aAccumulators[i];
+            accumulator ^= accumulator >> 47;
+            accumulator ^= Read64(aSecret + 8 * i);
+            aAccumulators[i] = accumulator * PRIME32_1;
+        }
+    }
+
+#if XXH3_X86_SIMD
+    // half a stripe, 4 lanes
+    __attribute__((target("avx2"))) static __m256i AccumulateLaneAvx2(const __m256i aAccumulator, const uint8_t *aData,
+                                                                      const uint8_t *aSecret) noexcept
+    {
+        const auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(aData));
+        const auto key = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(aSecret)));
+        const auto product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+        const auto swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+        return _mm256_add_epi64(aAccumulator, _mm256_add_epi64(product, swapped));
+    }
+
+    __attribute__((target("avx2"))) static void AccumulateAvx2(uint64_t *aAccumulators, const uint8_t *aData,
+                                                               const uint8_t *aSecret, const size_t aStripes) noexcept
+    {
+        auto *accumulators = reinterpret_cast<__m256i *>(aAccumulators);
+        __m256i low = _mm256_loadu_si256(accumulators);
+        __m256i high = _mm256_loadu_si256(accumulators + 1);
+
+        for (size_t stripe = 0; stripe < aStripes; stripe++)
+        {
+            const auto *data = aData + stripe * STRIPE_SIZE;
+            const auto *secret = aSecret + stripe * SECRET_CONSUME_RATE;
+            low = AccumulateLaneAvx2(low, data, secret);
+            high = AccumulateLaneAvx2(high, data + 32, secret + 32);
+        }
+
+        _mm256_storeu_si256(accumulators, low);
+        _mm256_storeu_si256(accumulators + 1, high);
+    }
+
+    __attribute__((target("avx2"))) static void ScrambleAvx2(uint64_t *aAccumulators, const uint8_t *aSecret) noexcept
+    {
+        const auto prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+
+        auto *accumulators = reinterpret_cast<__m256i *>(aAccumulators);
+        for (size_t i = 0; i < 2; i++)
+        {
+            auto accumulator = _mm256_loadu_si256(accumulators + i);
+            accumulator = _mm256_xor_si256(accumulator, _mm256_srli_epi64(accumulator, 47));
+            accumulator = _mm256_xor_si256(accumulator,
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(aSecret) + i));
+
+            // 64 by 32 bits from two 32 by 32
+            const auto low = _mm256_mul_epu32(accumulator, prime);
+            const auto high = _mm256_mul_epu32(_mm256_srli_epi64(accumulator, 32), prime);
+            _mm256_storeu_si256(accumulators + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+        }
+    }
+
+    // GCC 12 warns about the undefined vectors inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    __attribute__((target("avx512f"))) static void AccumulateAvx512(uint64_t *aAccumulators, const uint8_t *aData,
+                                                                    const uint8_t *aSecret,
+                                                                    const size_t aStripes) noexcept
+    {
+        auto accumulator = _mm512_loadu_si512(aAccumulators);
+
+        for (size_t stripe = 0; stripe < aStripes; stripe++)
+        {
+            const auto value = _mm512_loadu_si512(aData + stripe * STRIPE_SIZE);
+            const auto key = _mm512_xor_si512(value, _mm512_loadu_si512(aSecret + stripe * SECRET_CONSUME_RATE));
+            const auto product = _mm512_mul_epu32(key, _mm512_srli_epi64(key, 32));
+            const auto swapped = _mm512_shuffle_epi32(value, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(1, 0, 3, 2)));
+            accumulator = _mm512_add_epi64(accumulator, _mm512_add_epi64(product, swapped));
+        }
+
+        _mm512_storeu_si512(aAccumulators, accumulator);
+    }
+
+    __attribute__((target("avx512f"))) static void ScrambleAvx512(uint64_t *aAccumulators,
+                                                                  const uint8_t *aSecret) noexcept
+    {
+        const auto prime = _mm512_set1_epi32(static_cast<int>(PRIME32_1));
+
+        auto accumulator = _mm512_loadu_si512(aAccumulators);
+        accumulator = _mm512_xor_si512(accumulator, _mm512_srli_epi64(accumulator, 47));
+        accumulator = _mm512_xor_si512(accumulator, _mm512_loadu_si512(aSecret));
+
+        const auto low = _mm512_mul_epu32(accumulator, prime);
+        const auto high = _mm512_mul_epu32(_mm512_srli_epi64(accumulator, 32), prime);
+        _mm512_storeu_si512(aAccumulators, _mm512_add_epi64(low, _mm512_slli_epi64(high, 32)));
+    }
+
+#pragma GCC diagnostic pop
+#endif // XXH3_X86_SIMD
+};
@@ -0,0 +1,299 @@
+#include "HashingStream.hpp"
+#include "TreeHash.hpp"
+#include "XXHash64.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// the reference digests, then the same data streamed in uneven pieces and from an unaligned address
+bool Verify()
+{
+    constexpr std::pair<std::string_view, uint64_t> vectors[] = {
+        {"", 0xEF46DB3751D8E999},
+        {"abc", 0x44BC2CF5AD770999},
+        {"Nobody inspects the spammish repetition", 0xFBCEA83C8A378BF1},
+    };
+
+    for (const auto &[string, digest] : vectors)
+    {
+        if (XXHash64::DigestString(string) != digest)
+        {
+            std::cout << "wrong digest of \"" << string << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> data(100'003);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    const auto digest = XXHash64::DigestData({data.data() + 1, data.size() - 1});
+
+    XXHash64 hasher;
+    for (size_t offset = 1, piece = 1; offset < data.size(); offset += piece, piece = piece * 3 % 1'021 + 1)
+    {
+        hasher.Update({data.data() + offset, std::min(piece, data.size() - offset)});
+    }
+
+    if (hasher.Digest() != digest)
+    {
+        std::cout << "wrong streamed digest" << std::endl;
+        return false;
+    }
+
+    // this file copied through a tee, hashed on the way
+    std::ifstream ifs(__FILE__, std::ios::binary);
+    std::ostringstream copy;
+    HashingStreambuf tee(ifs.rdbuf(), XXHash64());
+    if (!(copy << &tee) || tee.Digest() != XXHash64::DigestFile(__FILE__) ||
+        tee.Digest() != XXHash64::DigestString(copy.str()))
+    {
+        std::cout << "wrong digest through the tee" << std::endl;
+        return false;
+    }
+
+#if FILE_READER_POSIX
+    // this file again through a FIFO, which can neither be mapped nor read at an offset
+    const auto fifo = std::filesystem::temp_directory_path() / "XXHash64 Benchmark.fifo";
+    std::filesystem::remove(fifo);
+    if (!mkfifo(fifo.c_str(), 0600))
+    {
+        for (const auto mode : {FileReader::Mode::STREAM, FileReader::Mode::READ, FileReader::Mode::MAP})
+        {
+            std::thread writer([&fifo] {
+                std::ofstream(fifo, std::ios::binary) << std::ifstream(__FILE__, std::ios::binary).rdbuf();
+            });
+            const auto fifoDigest = XXHash64::DigestFile(fifo, FileReader::CHUNK_SIZE, mode);
+            writer.join();
+
+            if (fifoDigest != tee.Digest())
+            {
+                std::cout << "wrong digest of a FIFO in mode " << static_cast<int>(mode) << std::endl;
+                std::filesystem::remove(fifo);
+                return false;
+            }
+        }
+        std::filesystem::remove(fifo);
+    }
+#endif // FILE_READER_POSIX
+
+    // keys of every size up to 2 chunks and then some, both batches against one at a time, on every kernel
+    const auto simdBest = XXHash64::GetSimd();
+    for (const auto simd : {XXHash64::Simd::SCALAR, XXHash64::Simd::AVX512})
+    {
+        if (!XXHash64::SetSimd(simd))
+        {
+            continue;
+        }
+
+        for (size_t keySize = 0; keySize <= 70; keySize++)
+        {
+            constexpr size_t count = 37;
+
+            std::vector<std::span<const uint8_t>> keys;
+            for (size_t i = 0; i < count; i++)
+            {
+                keys.emplace_back(data.data() + i * keySize, keySize);
+            }
+
+            std::vector<uint64_t> digests(count);
+            std::vector<uint64_t> fixedDigests(count);
+            XXHash64::DigestBatch(keys, digests);
+            XXHash64::DigestBatch({data.data(), count * keySize}, keySize, fixedDigests);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (digests[i] != XXHash64::DigestData(keys[i]) || fixedDigests[i] != digests[i])
+                {
+                    std::cout << "wrong batch digest of " << keySize << " B keys" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    XXHash64::SetSimd(simdBest);
+
+    return true;
+}
+
+void BenchmarkThroughput()
+{
+    constexpr size_t sizeMax = size_t{1} << 30;
+    constexpr size_t bytesPerSize = size_t{1} << 30; // hashed in total for each size
+
+    std::vector<uint8_t> data(sizeMax + 16);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    for (size_t size = 16; size <= sizeMax; size *= 4)
+    {
+        const auto count = std::max<size_t>(bytesPerSize / size, 1);
+
+        // each digest feeds the next one's offset so that none can be skipped
+        uint64_t digest{};
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            digest = XXHash64::DigestData({data.data() + digest % 16, size});
+        }
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+        std::cout << size << " B: " << count * size / duration.count() / 1'000'000'000 << " GB/s, "
+                  << duration.count() * 1'000'000'000 / count << " ns per digest" << std::endl;
+    }
+}
+
+// 1M keys of each size one at a time, in a batch of spans and in a fixed size batch on every kernel
+void BenchmarkBatch()
+{
+    constexpr size_t count = size_t{1} << 20;
+    constexpr size_t rounds = 10;
+
+    for (const size_t keySize : {8, 16, 32, 64})
+    {
+        std::vector<uint8_t> data(count * keySize);
+        std::iota(data.begin(), data.end(), uint8_t{});
+
+        std::vector<std::span<const uint8_t>> keys;
+        for (size_t i = 0; i < count; i++)
+        {
+            keys.emplace_back(data.data() + i * keySize, keySize);
+        }
+
+        std::vector<uint64_t> digests(count);
+        const auto measure = [&](const auto &aDigest) {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < rounds; i++)
+            {
+                aDigest();
+            }
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+            return rounds * count / duration.count() / 1'000'000;
+        };
+
+        std::cout << keySize << " B keys: DigestData "
+                  << measure([&] {
+                         for (size_t i = 0; i < count; i++)
+                         {
+                             digests[i] = XXHash64::DigestData(keys[i]);
+                         }
+                     })
+                  << " M/s, batch " << measure([&] { XXHash64::DigestBatch(keys, digests); }) << " M/s";
+
+        constexpr std::pair<XXHash64::Simd, std::string_view> kernels[] = {{XXHash64::Simd::SCALAR, "scalar"},
+                                                                           {XXHash64::Simd::AVX512, "AVX-512"}};
+        for (const auto &[simd, name] : kernels)
+        {
+            if (XXHash64::SetSimd(simd))
+            {
+                const auto fixed = measure([&] { XXHash64::DigestBatch(data, keySize, digests); });
+                std::cout << ", fixed " << name << " " << fixed << " M/s";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+// a file of each size written to the temporary directory, then hashed in every mode with the page cache warm
+// except for the files larger than the memory, skipped without twice their size free
+void BenchmarkFiles()
+{
+    constexpr uint64_t sizes[] = {uint64_t{4} << 10, uint64_t{1} << 20, uint64_t{64} << 20, uint64_t{1} << 30,
+                                  uint64_t{8} << 30};
+    constexpr std::pair<FileReader::Mode, std::string_view> modes[] = {
+        {FileReader::Mode::STREAM, "stream"}, {FileReader::Mode::READ, "read"}, {FileReader::Mode::MAP, "map"}};
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto file = directory / "XXHash64 Benchmark.bin";
+
+    std::vector<uint8_t> data(1 << 20);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    for (const auto size : sizes)
+    {
+        if (std::filesystem::space(directory).available < 2 * size)
+        {
+            std::cout << size << " B file: skipped, not enough space" << std::endl;
+            continue;
+        }
+
+        {
+            std::ofstream ofs(file, std::ios::binary);
+            for (uint64_t written = 0; written < size; written += data.size())
+            {
+                ofs.write(reinterpret_cast<const char *>(data.data()), std::min<uint64_t>(data.size(), size - written));
+            }
+        }
+
+        const auto expected = XXHash64::DigestFile(file, FileReader::CHUNK_SIZE, FileReader::Mode::STREAM);
+        const auto count = std::max<uint64_t>((uint64_t{1} << 30) / size, 1);
+
+        for (const auto &[mode, name] : modes)
+        {
+            bool same = true;
+            const auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < count; i++)
+            {
+                same &= XXHash64::DigestFile(file, FileReader::CHUNK_SIZE, mode) == expected;
+            }
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            std::cout << size << " B file, " << name << ": " << count * size / duration.count() / 1'000'000'000
+                      << " GB/s" << (same ? "" : ", wrong digest") << std::endl;
+        }
+    }
+
+    std::filesystem::remove(file);
+}
+
+// plain against tree digests of 1 GiB on 1 thread and on all of them, then one changed byte re-hashed
+void BenchmarkTree()
+{
+    std::vector<uint8_t> data(size_t{1} << 30);
+    std::iota(data.begin(), data.end(), uint8_t{});
+
+    const auto measure = [&](const auto &aDigest) {
+        const auto start = std::chrono::steady_clock::now();
+        const auto digest = aDigest();
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        return std::pair(digest, duration.count() * 1'000);
+    };
+
+    const auto hash = [](const std::span<const uint8_t> aData) { return XXHash64::DigestData(aData); };
+    TreeHash single(hash, TreeHash<decltype(hash)>::LEAF_SIZE, 1);
+    TreeHash all(hash);
+
+    const auto [plain, plainMilliseconds] = measure([&] { return XXHash64::DigestData(data); });
+    const auto [root, singleMilliseconds] = measure([&] { return single.Digest(data); });
+    const auto [rootAll, allMilliseconds] = measure([&] { return all.Digest(data); });
+
+    data[data.size() / 2]++;
+    const auto [updated, updateMilliseconds] = measure([&] { return all.Update(data, data.size() / 2, 1); });
+
+    std::cout << "1 GiB: plain " << plainMilliseconds << " ms, tree on 1 thread " << singleMilliseconds
+              << " ms, tree on " << std::max(std::thread::hardware_concurrency(), 1u) << " threads " << allMilliseconds
+              << " ms, 1 changed byte " << updateMilliseconds << " ms" << (root == rootAll ? "" : ", different roots")
+              << (single.Digest(data) == updated ? "" : ", wrong update") << std::endl;
+    std::cout << std::hex << "plain " << plain << ", root " << root << std::dec << std::endl;
+}
+
+int main()
+{
+    if (!Verify())
+    {
+        return 1;
+    }
+
+    BenchmarkThroughput();
+    BenchmarkBatch();
+    BenchmarkFiles();
+    BenchmarkTree();
+
+    return 0;
+}
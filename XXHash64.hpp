@@ -1,15 +1,34 @@
+#pragma once
+
+#include "FileReader.hpp"
+
 #include <array>
 #include <bit>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
+#include <limits>
 #include <span>
 #include <string_view>
 #include <vector>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define XXHASH64_X86_SIMD 1
+#else
+#define XXHASH64_X86_SIMD 0
+#endif
+
 class XXHash64
 {
   public:
+    enum class Simd : uint8_t
+    {
+        SCALAR,
+        AVX512
+    };
+
     static constexpr uint64_t DigestData(const std::span<const uint8_t> aData) noexcept
     {
         XXHash64 hasher;
@@ -22,26 +41,102 @@ class XXHash64
         return DigestData({std::bit_cast<const uint8_t *>(aString.data()), aString.size()});
     }
 
-    static uint64_t DigestFile(const std::filesystem::path &aFile, const uint64_t aChunkSize = 64 * 1024) noexcept
+    static uint64_t DigestFile(const std::filesystem::path &aFile, const uint64_t aChunkSize = FileReader::CHUNK_SIZE,
+                               const FileReader::Mode aMode = FileReader::Mode::MAP) noexcept
     {
-        std::ifstream ifs(aFile, std::ios::binary);
-        if (!ifs)
+        XXHash64 hasher;
+        const auto update = [&](const std::span<const uint8_t> aData) { hasher.Update(aData); };
+        if (!FileReader::Read(aFile, update, aMode, aChunkSize))
         {
             return {};
         }
 
-        XXHash64 hasher;
-        std::vector<uint8_t> buffer(aChunkSize);
+        return hasher.Digest();
+    }
 
-        while (ifs.read(reinterpret_cast<char *>(buffer.data()), buffer.size()))
+    // many short independent keys, each straight from its memory without a hasher, 4 of the same size at a time
+    // interleaved so that their multiplications overlap
+    static void DigestBatch(const std::span<const std::span<const uint8_t>> aKeys, const std::span<uint64_t> aDigests,
+                            const uint64_t aSeed = {}) noexcept
+    {
+        assert(aDigests.size() >= aKeys.size());
+
+        size_t i = 0;
+        for (; i + 4 <= aKeys.size(); i += 4)
         {
-            hasher.Update(buffer);
+            const auto size = aKeys[i].size();
+            if (aKeys[i + 1].size() == size && aKeys[i + 2].size() == size && aKeys[i + 3].size() == size)
+            {
+                DigestLanes<4>({aKeys[i].data(), aKeys[i + 1].data(), aKeys[i + 2].data(), aKeys[i + 3].data()}, size,
+                               aSeed, &aDigests[i]);
+                continue;
+            }
+
+            for (size_t j = i; j < i + 4; j++)
+            {
+                DigestLanes<1>({aKeys[j].data()}, aKeys[j].size(), aSeed, &aDigests[j]);
+            }
         }
 
-        const auto fileSizeTotal = std::filesystem::file_size(aFile);
-        hasher.Update({buffer.data(), fileSizeTotal % aChunkSize});
+        for (; i < aKeys.size(); i++)
+        {
+            DigestLanes<1>({aKeys[i].data()}, aKeys[i].size(), aSeed, &aDigests[i]);
+        }
+    }
 
-        return hasher.Digest();
+    // aKeys holds keys of aKeySize bytes back to back, 16 at a time in the AVX-512 lanes when available
+    static void DigestBatch(const std::span<const uint8_t> aKeys, const size_t aKeySize,
+                            const std::span<uint64_t> aDigests, const uint64_t aSeed = {}) noexcept
+    {
+        const auto count = aKeySize ? aKeys.size() / aKeySize : aDigests.size();
+        assert(aDigests.size() >= count);
+
+        const auto *keys = aKeys.data();
+        size_t i = 0;
+
+#if XXHASH64_X86_SIMD
+        if (sSimd == Simd::AVX512)
+        {
+            for (; i + 16 <= count; i += 16)
+            {
+                DigestLanesAvx512<2>(keys + i * aKeySize, aKeySize, aSeed, &aDigests[i]);
+            }
+
+            for (; i + 8 <= count; i += 8)
+            {
+                DigestLanesAvx512<1>(keys + i * aKeySize, aKeySize, aSeed, &aDigests[i]);
+            }
+        }
+#endif // XXHASH64_X86_SIMD
+
+        for (; i + 4 <= count; i += 4)
+        {
+            const auto *key = keys + i * aKeySize;
+            DigestLanes<4>({key, key + aKeySize, key + 2 * aKeySize, key + 3 * aKeySize}, aKeySize, aSeed,
+                           &aDigests[i]);
+        }
+
+        for (; i < count; i++)
+        {
+            DigestLanes<1>({keys + i * aKeySize}, aKeySize, aSeed, &aDigests[i]);
+        }
+    }
+
+    // the lanes of the fixed size batches, the best one supported is picked at startup, for tests and benchmarks
+    static Simd GetSimd() noexcept
+    {
+        return sSimd;
+    }
+
+    static bool SetSimd(const Simd aSimd) noexcept
+    {
+        if (aSimd > DetectSimd())
+        {
+            return false;
+        }
+
+        sSimd = aSimd;
+        return true;
     }
 
   public:
@@ -76,10 +171,11 @@ class XXHash64
             ProcessChunk(mBuffer, mState);
         }
 
-        while (dataOffset <= dataEnd)
+        if (dataOffset <= dataEnd)
         {
-            ProcessChunk(aData.subspan(dataOffset, mBuffer.size()), mState);
-            dataOffset += mBuffer.size();
+            const auto chunksSize = (aData.size() - dataOffset) / mBuffer.size() * mBuffer.size();
+            ProcessChunks(aData.subspan(dataOffset, chunksSize), mState);
+            dataOffset += chunksSize;
         }
 
         // fill the buffer with the remaining data
@@ -91,16 +187,8 @@ class XXHash64
 
     constexpr uint64_t Digest() const noexcept
     {
-        uint64_t result{};
-        if (mTotalSize >= mBuffer.size())
-        {
-            result = FoldChunkIntoBlock();
-        }
-        else
-        {
-            // take original seed
-            result = mState[2] + PRIME_5;
-        }
+        // take original seed if the states were never used
+        auto result = mTotalSize >= mBuffer.size() ? FoldStates(mState) : mState[2] + PRIME_5;
         result += mTotalSize;
 
         uint64_t dataOffset{};
@@ -108,53 +196,70 @@ class XXHash64
         // process one block at a time
         for (; dataOffset + sizeof(uint64_t) <= mBufferOffset; dataOffset += sizeof(uint64_t))
         {
-            const auto block = *std::bit_cast<const uint64_t *>(mBuffer.data() + dataOffset);
-            result = RotateLeft(result ^ ProcessBlock(0, block), 27) * PRIME_1 + PRIME_4;
+            result = MergeBlock(result, *std::bit_cast<const uint64_t *>(mBuffer.data() + dataOffset));
         }
 
         // if half a block left, process it
         if (dataOffset + sizeof(uint32_t) <= mBufferOffset)
         {
-            const auto block = *std::bit_cast<const uint32_t *>(mBuffer.data() + dataOffset);
-            result = RotateLeft(result ^ block * PRIME_1, 23) * PRIME_2 + PRIME_3;
+            result = MergeHalfBlock(result, *std::bit_cast<const uint32_t *>(mBuffer.data() + dataOffset));
             dataOffset += sizeof(uint32_t);
         }
 
         // process the remaining bytes
         while (dataOffset != mBufferOffset)
         {
-            result = RotateLeft(result ^ mBuffer[dataOffset++] * PRIME_5, 11) * PRIME_1;
+            result = MergeByte(result, mBuffer[dataOffset++]);
         }
 
-        // mix
-        result ^= result >> 33;
-        result *= PRIME_2;
-        result ^= result >> 29;
-        result *= PRIME_3;
-        result ^= result >> 32;
-
-        return result;
+        return Mix(result);
     }
 
   private:
-    constexpr uint64_t FoldChunkIntoBlock() const noexcept
+    static constexpr uint64_t FoldStates(const std::span<const uint64_t, 4> aStates) noexcept
     {
         uint64_t result{};
 
         constexpr std::array<uint8_t, BLOCKS_PER_CHUNK> bits{1, 7, 12, 18};
         for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
         {
-            result += RotateLeft(mState[i], bits[i]);
+            result += RotateLeft(aStates[i], bits[i]);
         }
 
         for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
         {
-            result = (result ^ ProcessBlock(0, mState[i])) * PRIME_1 + PRIME_4;
+            result = (result ^ ProcessBlock(0, aStates[i])) * PRIME_1 + PRIME_4;
         }
 
         return result;
     }
 
+    static constexpr uint64_t MergeBlock(const uint64_t aResult, const uint64_t aBlock) noexcept
+    {
+        return RotateLeft(aResult ^ ProcessBlock(0, aBlock), 27) * PRIME_1 + PRIME_4;
+    }
+
+    static constexpr uint64_t MergeHalfBlock(const uint64_t aResult, const uint32_t aHalfBlock) noexcept
+    {
+        return RotateLeft(aResult ^ aHalfBlock * PRIME_1, 23) * PRIME_2 + PRIME_3;
+    }
+
+    static constexpr uint64_t MergeByte(const uint64_t aResult, const uint8_t aByte) noexcept
+    {
+        return RotateLeft(aResult ^ aByte * PRIME_5, 11) * PRIME_1;
+    }
+
+    static constexpr uint64_t Mix(uint64_t aResult) noexcept
+    {
+        aResult ^= aResult >> 33;
+        aResult *= PRIME_2;
+        aResult ^= aResult >> 29;
+        aResult *= PRIME_3;
+        aResult ^= aResult >> 32;
+
+        return aResult;
+    }
+
     static constexpr uint64_t RotateLeft(uint64_t aData, unsigned char aBits) noexcept
     {
         return (aData << aBits) | (aData >> (std::numeric_limits<uint64_t>::digits - aBits));
@@ -174,6 +279,325 @@ class XXHash64
         }
     }
 
+    // the bulk path, the lanes stay in registers across the chunks instead of going through aStates for each one
+    static void ProcessChunks(const std::span<const uint8_t> aData, const std::span<uint64_t> aStates) noexcept
+    {
+        auto state0 = aStates[0];
+        auto state1 = aStates[1];
+        auto state2 = aStates[2];
+        auto state3 = aStates[3];
+
+        const auto *data = aData.data();
+        const auto *end = data + aData.size();
+        for (; data != end; data += BLOCKS_PER_CHUNK * sizeof(uint64_t))
+        {
+            state0 = ProcessBlock(state0, ReadBlock(data));
+            state1 = ProcessBlock(state1, ReadBlock(data + sizeof(uint64_t)));
+            state2 = ProcessBlock(state2, ReadBlock(data + 2 * sizeof(uint64_t)));
+            state3 = ProcessBlock(state3, ReadBlock(data + 3 * sizeof(uint64_t)));
+        }
+
+        aStates[0] = state0;
+        aStates[1] = state1;
+        aStates[2] = state2;
+        aStates[3] = state3;
+    }
+
+    // unaligned
+    static uint64_t ReadBlock(const uint8_t *aData) noexcept
+    {
+        uint64_t block;
+        std::memcpy(&block, aData, sizeof(block));
+        return block;
+    }
+
+    // LANES keys of aSize bytes hashed in lockstep, the same steps as Update and Digest without the buffer
+    template <size_t LANES>
+    static void DigestLanes(const std::array<const uint8_t *, LANES> &aKeys, const size_t aSize, const uint64_t aSeed,
+                            uint64_t *aDigests) noexcept
+    {
+        constexpr size_t chunkSize = BLOCKS_PER_CHUNK * sizeof(uint64_t);
+
+        std::array<uint64_t, LANES> results;
+        size_t offset{};
+
+        if (aSize >= chunkSize)
+        {
+            std::array<std::array<uint64_t, BLOCKS_PER_CHUNK>, LANES> states;
+            for (auto &state : states)
+            {
+                state = {aSeed + PRIME_1 + PRIME_2, aSeed + PRIME_2, aSeed, aSeed - PRIME_1};
+            }
+
+            // a lane at a time, all the lanes' states do not fit in the registers
+            const auto chunksSize = aSize / chunkSize * chunkSize;
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                ProcessChunks({aKeys[lane], chunksSize}, states[lane]);
+            }
+            offset = chunksSize;
+
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                results[lane] = FoldStates(states[lane]) + aSize;
+            }
+        }
+        else
+        {
+            results.fill(aSeed + PRIME_5 + aSize);
+        }
+
+        for (; offset + sizeof(uint64_t) <= aSize; offset += sizeof(uint64_t))
+        {
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                results[lane] = MergeBlock(results[lane], ReadBlock(aKeys[lane] + offset));
+            }
+        }
+
+        if (offset + sizeof(uint32_t) <= aSize)
+        {
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                uint32_t halfBlock;
+                std::memcpy(&halfBlock, aKeys[lane] + offset, sizeof(halfBlock));
+                results[lane] = MergeHalfBlock(results[lane], halfBlock);
+            }
+            offset += sizeof(uint32_t);
+        }
+
+        for (; offset < aSize; offset++)
+        {
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                results[lane] = MergeByte(results[lane], aKeys[lane][offset]);
+            }
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++)
+        {
+            aDigests[lane] = Mix(results[lane]);
+        }
+    }
+
+    static Simd DetectSimd() noexcept
+    {
+#if XXHASH64_X86_SIMD
+        // the 64 bits multiplications are AVX-512 DQ
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+        {
+            return Simd::AVX512;
+        }
+#endif // XXHASH64_X86_SIMD
+
+        return Simd::SCALAR;
+    }
+
+    static inline Simd sSimd = DetectSimd();
+
+#if XXHASH64_X86_SIMD
+    // GCC 12 warns about the undefined vectors inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    __attribute__((target("avx512f,avx512dq"))) static __m512i ProcessBlockAvx512(const __m512i aPrevious,
+                                                                                   const __m512i aInput) noexcept
+    {
+        const auto sum = _mm512_add_epi64(aPrevious, _mm512_mullo_epi64(aInput, _mm512_set1_epi64(PRIME_2)));
+        return _mm512_mullo_epi64(_mm512_rol_epi64(sum, 31), _mm512_set1_epi64(PRIME_1));
+    }
+
+    // 8 keys' blocks at aOffset, one per 64 bits lane, the keys of 8 or 16 bytes are loaded and shuffled, the others
+    // gathered
+    __attribute__((target("avx512f,avx512dq"))) static __m512i LoadBlocksAvx512(const uint8_t *aKeys,
+                                                                              const size_t aKeySize,
+                                                                              const size_t aOffset,
+                                                                              const __m512i aIndexes) noexcept
+    {
+        switch (aKeySize)
+        {
+        case sizeof(uint64_t):
+            return _mm512_loadu_si512(aKeys);
+
+        case 2 * sizeof(uint64_t): {
+            const auto blocks = _mm512_add_epi64(_mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14),
+                                                 _mm512_set1_epi64(aOffset / sizeof(uint64_t)));
+            return _mm512_permutex2var_epi64(_mm512_loadu_si512(aKeys), blocks, _mm512_loadu_si512(aKeys + 64));
+        }
+
+        default:
+            return _mm512_i64gather_epi64(aIndexes, aKeys + aOffset, 1);
+        }
+    }
+
+    // 8 keys' chunks at aOffset transposed into their 4 blocks, a vector per block and a lane per key
+    __attribute__((target("avx512f,avx512dq"))) static void LoadChunksAvx512(const uint8_t *aKeys,
+                                                                              const size_t aKeySize,
+                                                                              const size_t aOffset,
+                                                                              __m512i *aBlocks) noexcept
+    {
+        // 2 keys' chunks per vector
+        __m512i chunks[4];
+        for (size_t i = 0; i < 4; i++)
+        {
+            const auto *key = aKeys + 2 * i * aKeySize + aOffset;
+            const auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key));
+            const auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key + aKeySize));
+            chunks[i] = _mm512_inserti64x4(_mm512_castsi256_si512(low), high, 1);
+        }
+
+        // blocks 0 and 1 then 2 and 3 of 4 keys, then of the 8
+        const auto blocks01 = _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13);
+        const auto blocks23 = _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15);
+        const auto low = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+        const auto high = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+
+        const auto keys0123Blocks01 = _mm512_permutex2var_epi64(chunks[0], blocks01, chunks[1]);
+        const auto keys4567Blocks01 = _mm512_permutex2var_epi64(chunks[2], blocks01, chunks[3]);
+        const auto keys0123Blocks23 = _mm512_permutex2var_epi64(chunks[0], blocks23, chunks[1]);
+        const auto keys4567Blocks23 = _mm512_permutex2var_epi64(chunks[2], blocks23, chunks[3]);
+
+        aBlocks[0] = _mm512_permutex2var_epi64(keys0123Blocks01, low, keys4567Blocks01);
+        aBlocks[1] = _mm512_permutex2var_epi64(keys0123Blocks01, high, keys4567Blocks01);
+        aBlocks[2] = _mm512_permutex2var_epi64(keys0123Blocks23, low, keys4567Blocks23);
+        aBlocks[3] = _mm512_permutex2var_epi64(keys0123Blocks23, high, keys4567Blocks23);
+    }
+
+    __attribute__((target("avx512f,avx512dq"))) static __m512i MixAvx512(__m512i aResults) noexcept
+    {
+        aResults = _mm512_xor_si512(aResults, _mm512_srli_epi64(aResults, 33));
+        aResults = _mm512_mullo_epi64(aResults, _mm512_set1_epi64(PRIME_2));
+        aResults = _mm512_xor_si512(aResults, _mm512_srli_epi64(aResults, 29));
+        aResults = _mm512_mullo_epi64(aResults, _mm512_set1_epi64(PRIME_3));
+        return _mm512_xor_si512(aResults, _mm512_srli_epi64(aResults, 32));
+    }
+
+    // DigestLanes on 8 keys per vector, one per 64 bits lane, VECTORS of them in lockstep to hide the latency of the
+    // multiplications
+    template <size_t VECTORS>
+    __attribute__((target("avx512f,avx512dq"))) static void DigestLanesAvx512(const uint8_t *aKeys,
+                                                                               const size_t aKeySize,
+                                                                               const uint64_t aSeed,
+                                                                               uint64_t *aDigests) noexcept
+    {
+        constexpr size_t KEYS_PER_VECTOR = 8;
+        constexpr size_t chunkSize = BLOCKS_PER_CHUNK * sizeof(uint64_t);
+
+        const auto indexes = _mm512_mullo_epi64(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64(aKeySize));
+        const auto prime1 = _mm512_set1_epi64(PRIME_1);
+        const auto prime4 = _mm512_set1_epi64(PRIME_4);
+        const auto vectorSize = KEYS_PER_VECTOR * aKeySize;
+
+        __m512i results[VECTORS];
+        size_t offset{};
+
+        if (aKeySize >= chunkSize)
+        {
+            __m512i states[VECTORS][BLOCKS_PER_CHUNK];
+            for (auto &state : states)
+            {
+                state[0] = _mm512_set1_epi64(aSeed + PRIME_1 + PRIME_2);
+                state[1] = _mm512_set1_epi64(aSeed + PRIME_2);
+                state[2] = _mm512_set1_epi64(aSeed);
+                state[3] = _mm512_set1_epi64(aSeed - PRIME_1);
+            }
+
+            for (; offset + chunkSize <= aKeySize; offset += chunkSize)
+            {
+                for (size_t v = 0; v < VECTORS; v++)
+                {
+                    __m512i blocks[BLOCKS_PER_CHUNK];
+                    LoadChunksAvx512(aKeys + v * vectorSize, aKeySize, offset, blocks);
+
+                    for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
+                    {
+                        states[v][i] = ProcessBlockAvx512(states[v][i], blocks[i]);
+                    }
+                }
+            }
+
+            for (size_t v = 0; v < VECTORS; v++)
+            {
+                results[v] = _mm512_add_epi64(_mm512_rol_epi64(states[v][0], 1), _mm512_rol_epi64(states[v][1], 7));
+                results[v] = _mm512_add_epi64(results[v], _mm512_rol_epi64(states[v][2], 12));
+                results[v] = _mm512_add_epi64(results[v], _mm512_rol_epi64(states[v][3], 18));
+            }
+
+            for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
+            {
+                for (size_t v = 0; v < VECTORS; v++)
+                {
+                    results[v] = _mm512_xor_si512(results[v], ProcessBlockAvx512(_mm512_setzero_si512(), states[v][i]));
+                    results[v] = _mm512_add_epi64(_mm512_mullo_epi64(results[v], prime1), prime4);
+                }
+            }
+
+            for (auto &result : results)
+            {
+                result = _mm512_add_epi64(result, _mm512_set1_epi64(aKeySize));
+            }
+        }
+        else
+        {
+            for (auto &result : results)
+            {
+                result = _mm512_set1_epi64(aSeed + PRIME_5 + aKeySize);
+            }
+        }
+
+        for (; offset + sizeof(uint64_t) <= aKeySize; offset += sizeof(uint64_t))
+        {
+            for (size_t v = 0; v < VECTORS; v++)
+            {
+                const auto blocks = LoadBlocksAvx512(aKeys + v * vectorSize, aKeySize, offset, indexes);
+                results[v] = _mm512_xor_si512(results[v], ProcessBlockAvx512(_mm512_setzero_si512(), blocks));
+                results[v] = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_rol_epi64(results[v], 27), prime1), prime4);
+            }
+        }
+
+        if (offset == aKeySize)
+        {
+            for (size_t v = 0; v < VECTORS; v++)
+            {
+                _mm512_storeu_si512(aDigests + v * KEYS_PER_VECTOR, MixAvx512(results[v]));
+            }
+            return;
+        }
+
+        // the rest of the keys is too short to gather without reading past the last one
+        alignas(64) std::array<uint64_t, VECTORS * KEYS_PER_VECTOR> lanes;
+        for (size_t v = 0; v < VECTORS; v++)
+        {
+            _mm512_store_si512(lanes.data() + v * KEYS_PER_VECTOR, results[v]);
+        }
+
+        for (size_t lane = 0; lane < lanes.size(); lane++)
+        {
+            const auto *key = aKeys + lane * aKeySize;
+            auto result = lanes[lane];
+            auto keyOffset = offset;
+
+            if (keyOffset + sizeof(uint32_t) <= aKeySize)
+            {
+                uint32_t halfBlock;
+                std::memcpy(&halfBlock, key + keyOffset, sizeof(halfBlock));
+                result = MergeHalfBlock(result, halfBlock);
+                keyOffset += sizeof(uint32_t);
+            }
+
+            for (; keyOffset < aKeySize; keyOffset++)
+            {
+                result = MergeByte(result, key[keyOffset]);
+            }
+
+            aDigests[lane] = Mix(result);
+        }
+    }
+
+#pragma GCC diagnostic pop
+#endif // XXHASH64_X86_SIMD
+
   private:
     uint64_t AppendToBuffer(const std::span<const uint8_t> aData) noexcept
     {
@@ -185,11 +609,11 @@ class XXHash64
     }
 
   private:
-    static constexpr uint64_t PRIME_1 = 11400714785074694791;
-    static constexpr uint64_t PRIME_2 = 14029467366897019727;
-    static constexpr uint64_t PRIME_3 = 1609587929392839161;
-    static constexpr uint64_t PRIME_4 = 9650029242287828579;
-    static constexpr uint64_t PRIME_5 = 2870177450012600261;
+    static constexpr uint64_t PRIME_1 = 11400714785074694791ULL;
+    static constexpr uint64_t PRIME_2 = 14029467366897019727ULL;
+    static constexpr uint64_t PRIME_3 = 1609587929392839161ULL;
+    static constexpr uint64_t PRIME_4 = 9650029242287828579ULL;
+    static constexpr uint64_t PRIME_5 = 2870177450012600261ULL;
 
     static constexpr uint8_t BLOCKS_PER_CHUNK = 4;
 
@@ -199,8 +623,3 @@ class XXHash64
     uint64_t mBufferOffset{};
     uint64_t mTotalSize{};
 };
-
-int main()
-{
-    return 0;
-}